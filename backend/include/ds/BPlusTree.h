@@ -0,0 +1,589 @@
+#pragma once
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <mutex>
+#include "BufferPool.h"
+#include "WriteAheadLog.h"
+
+using namespace std;
+
+#define BPLUS_PAGE_SIZE 16384
+#define BPLUS_PAGE_HEADER 16
+#define BPLUS_FILE_HEADER 16
+#define BPLUS_MAGIC 0x31545042u // "BPT1"
+
+// In-place accessor for one page. Layout:
+//   [isLeaf:1][pad:3][numKeys:4][prev:4][next:4]
+//   leaf:     RecordType records[LEAF_CAPACITY]
+//   internal: KeyType keys[INTERNAL_CAPACITY], FilePos children[INTERNAL_CAPACITY + 1]
+// keys[i] is the smallest key under children[i + 1]. prev/next link the leaves.
+// The key is the leading bytes of the record (every model keeps its int id as
+// the first field), so leaf keys are read straight from the record bytes.
+// KeyType must be trivially copyable with operator< and operator==.
+template<typename RecordType, typename KeyType = int>
+struct BPlusPage {
+    static const int LEAF_CAPACITY = (BPLUS_PAGE_SIZE - BPLUS_PAGE_HEADER) / sizeof(RecordType);
+    static const int INTERNAL_CAPACITY = (BPLUS_PAGE_SIZE - BPLUS_PAGE_HEADER - sizeof(FilePos)) / (sizeof(KeyType) + sizeof(FilePos));
+    static const size_t CHILDREN_OFFSET = BPLUS_PAGE_HEADER + sizeof(KeyType) * INTERNAL_CAPACITY;
+
+    char* data;
+
+    BPlusPage(char* buffer) : data(buffer) {}
+
+    template<typename T>
+    T get(size_t offset) const {
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    void set(size_t offset, T value) {
+        memcpy(data + offset, &value, sizeof(T));
+    }
+
+    void init(bool leaf) {
+        memset(data, 0, BPLUS_PAGE_SIZE);
+        data[0] = leaf ? 1 : 0;
+        setPrev(-1);
+        setNext(-1);
+    }
+
+    bool isLeaf() const { return data[0] != 0; }
+    int numKeys() const { return get<int>(4); }
+    void setNumKeys(int n) { set<int>(4, n); }
+    FilePos prev() const { return get<FilePos>(8); }
+    void setPrev(FilePos pos) { set<FilePos>(8, pos); }
+    FilePos next() const { return get<FilePos>(12); }
+    void setNext(FilePos pos) { set<FilePos>(12, pos); }
+
+    char* recordAt(int i) const { return data + BPLUS_PAGE_HEADER + sizeof(RecordType) * i; }
+    KeyType recordKey(int i) const { return get<KeyType>(BPLUS_PAGE_HEADER + sizeof(RecordType) * i); }
+    void readRecord(int i, RecordType& out) const { memcpy(&out, recordAt(i), sizeof(RecordType)); }
+    void writeRecord(int i, const RecordType& record) { memcpy(recordAt(i), &record, sizeof(RecordType)); }
+
+    KeyType key(int i) const { return get<KeyType>(BPLUS_PAGE_HEADER + sizeof(KeyType) * i); }
+    void setKey(int i, KeyType k) { set<KeyType>(BPLUS_PAGE_HEADER + sizeof(KeyType) * i, k); }
+    FilePos child(int i) const { return get<FilePos>(CHILDREN_OFFSET + sizeof(FilePos) * i); }
+    void setChild(int i, FilePos pos) { set<FilePos>(CHILDREN_OFFSET + sizeof(FilePos) * i, pos); }
+
+    // First record whose key is >= id
+    int lowerBound(const KeyType& id) const {
+        int lo = 0, hi = numKeys();
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (recordKey(mid) < id) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // First record whose key is > id
+    int upperBound(const KeyType& id) const {
+        int lo = 0, hi = numKeys();
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (!(id < recordKey(mid))) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Child that may hold id
+    int childIndex(const KeyType& id) const {
+        int lo = 0, hi = numKeys();
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (!(id < key(mid))) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+};
+
+// Disk B+tree: internal pages hold only keys, so a 16 KB page fans out about
+// 2000 ways on int ids; records live in the leaves, which are linked in key
+// order.
+// Pages go through the shared BufferPool and mutations are committed to the
+// WriteAheadLog the same way BTree does it. Deleting only removes the record
+// from its leaf; leaves are never merged, and scans skip empty ones.
+template<typename RecordType, typename KeyType = int>
+class BPlusTree : public PageStore {
+private:
+    typedef BPlusPage<RecordType, KeyType> Page;
+
+    fstream file;
+    FilePos rootPos;
+    FilePos nextPos;
+    string filename;
+    mutex fileMutex;
+    BufferPool* pool;
+    int fileId;
+    WriteAheadLog* wal;
+
+    struct PinnedPage {
+        BufferPool* pool;
+        BufferPool::Frame* frame;
+        bool dirty;
+
+        PinnedPage(BufferPool* p, BufferPool::Frame* f) : pool(p), frame(f), dirty(false) {}
+        ~PinnedPage() { pool->unpin(frame, dirty); }
+
+        Page page() { return Page(frame->data.data()); }
+    };
+
+    BufferPool::Frame* pinPage(FilePos pos) {
+        return pool->pin(fileId, pos, BPLUS_PAGE_SIZE);
+    }
+
+    FilePos allocatePage(bool leaf) {
+        FilePos pos = nextPos;
+        nextPos += BPLUS_PAGE_SIZE;
+        PinnedPage pinned(pool, pool->pin(fileId, pos, BPLUS_PAGE_SIZE, false));
+        pinned.page().init(leaf);
+        pinned.dirty = true;
+        return pos;
+    }
+
+    bool writeFileHeader() {
+        uint32_t magic = BPLUS_MAGIC;
+        uint32_t pageSize = BPLUS_PAGE_SIZE;
+        lock_guard<mutex> lock(fileMutex);
+        file.clear();
+        file.seekp(0);
+        file.write(reinterpret_cast<char*>(&rootPos), sizeof(FilePos));
+        file.write(reinterpret_cast<char*>(&nextPos), sizeof(FilePos));
+        file.write(reinterpret_cast<char*>(&magic), sizeof(magic));
+        file.write(reinterpret_cast<char*>(&pageSize), sizeof(pageSize));
+        file.flush();
+        return !file.fail();
+    }
+
+    // Ends one public mutation, as in BTree::commitPages
+    void commitPages() {
+        if (!wal) {
+            pool->flushFile(fileId);
+            writeFileHeader();
+            return;
+        }
+        WALBatch batch;
+        vector<BufferPool::Frame*> frames = pool->pinUnlogged(fileId);
+        for (BufferPool::Frame* frame : frames) {
+            batch.addPage(filename, frame->pos, frame->data.data(), frame->data.size());
+        }
+        batch.addHeader(filename, rootPos, nextPos);
+        pool->markLogged(frames, wal->append(batch));
+    }
+
+    static KeyType keyOf(const RecordType& record) {
+        KeyType key;
+        memcpy(&key, &record, sizeof(KeyType));
+        return key;
+    }
+
+    FilePos findLeaf(const KeyType& id) {
+        FilePos pos = rootPos;
+        while (true) {
+            PinnedPage pinned(pool, pinPage(pos));
+            Page page = pinned.page();
+            if (page.isLeaf()) return pos;
+            pos = page.child(page.childIndex(id));
+        }
+    }
+
+    FilePos leftmostLeaf() {
+        FilePos pos = rootPos;
+        while (true) {
+            PinnedPage pinned(pool, pinPage(pos));
+            Page page = pinned.page();
+            if (page.isLeaf()) return pos;
+            pos = page.child(0);
+        }
+    }
+
+    FilePos rightmostLeaf() {
+        FilePos pos = rootPos;
+        while (true) {
+            PinnedPage pinned(pool, pinPage(pos));
+            Page page = pinned.page();
+            if (page.isLeaf()) return pos;
+            pos = page.child(page.numKeys());
+        }
+    }
+
+    // Inserts into the subtree at pos. When the page splits, returns true with
+    // the separator key and the new right sibling for the parent to link.
+    bool insertInto(FilePos pos, const RecordType& record, KeyType& splitKey, FilePos& splitPos) {
+        PinnedPage pinned(pool, pinPage(pos));
+        Page page = pinned.page();
+        KeyType id = keyOf(record);
+
+        if (page.isLeaf()) {
+            int index = page.lowerBound(id);
+            if (index < page.numKeys() && page.recordKey(index) == id) {
+                page.writeRecord(index, record);
+                pinned.dirty = true;
+                return false;
+            }
+            pinned.dirty = true;
+            if (page.numKeys() < Page::LEAF_CAPACITY) {
+                insertIntoLeaf(page, index, record);
+                return false;
+            }
+
+            // Split: the upper half moves to a new right sibling
+            FilePos rightPos = allocatePage(true);
+            PinnedPage rightPinned(pool, pinPage(rightPos));
+            Page right = rightPinned.page();
+            rightPinned.dirty = true;
+
+            int half = page.numKeys() / 2;
+            int moved = page.numKeys() - half;
+            memcpy(right.recordAt(0), page.recordAt(half), sizeof(RecordType) * moved);
+            right.setNumKeys(moved);
+            page.setNumKeys(half);
+
+            right.setNext(page.next());
+            right.setPrev(pos);
+            if (page.next() != -1) {
+                PinnedPage nextPinned(pool, pinPage(page.next()));
+                nextPinned.page().setPrev(rightPos);
+                nextPinned.dirty = true;
+            }
+            page.setNext(rightPos);
+
+            if (index <= half) {
+                insertIntoLeaf(page, index, record);
+            } else {
+                insertIntoLeaf(right, index - half, record);
+            }
+            splitKey = right.recordKey(0);
+            splitPos = rightPos;
+            return true;
+        }
+
+        int childIndex = page.childIndex(id);
+        KeyType childKey;
+        FilePos childPos;
+        if (!insertInto(page.child(childIndex), record, childKey, childPos)) {
+            return false;
+        }
+
+        pinned.dirty = true;
+        if (page.numKeys() < Page::INTERNAL_CAPACITY) {
+            insertIntoInternal(page, childIndex, childKey, childPos);
+            return false;
+        }
+
+        // Split: the middle key moves up, the keys after it go right
+        FilePos rightPos = allocatePage(false);
+        PinnedPage rightPinned(pool, pinPage(rightPos));
+        Page right = rightPinned.page();
+        rightPinned.dirty = true;
+
+        // Build the overfull key/child lists, then cut them
+        int n = page.numKeys();
+        vector<KeyType> keys(n + 1);
+        vector<FilePos> children(n + 2);
+        for (int i = 0, k = 0; i < n; i++, k++) {
+            if (i == childIndex) keys[k++] = childKey;
+            keys[k] = page.key(i);
+        }
+        if (childIndex == n) keys[n] = childKey;
+        for (int i = 0, c = 0; i <= n; i++, c++) {
+            children[c] = page.child(i);
+            if (i == childIndex) children[++c] = childPos;
+        }
+
+        int middle = (n + 1) / 2;
+        page.setNumKeys(middle);
+        for (int i = 0; i < middle; i++) {
+            page.setKey(i, keys[i]);
+            page.setChild(i, children[i]);
+        }
+        page.setChild(middle, children[middle]);
+
+        int rightKeys = n - middle;
+        right.setNumKeys(rightKeys);
+        for (int i = 0; i < rightKeys; i++) {
+            right.setKey(i, keys[middle + 1 + i]);
+            right.setChild(i, children[middle + 1 + i]);
+        }
+        right.setChild(rightKeys, children[n + 1]);
+
+        splitKey = keys[middle];
+        splitPos = rightPos;
+        return true;
+    }
+
+    static void insertIntoLeaf(Page& page, int index, const RecordType& record) {
+        int n = page.numKeys();
+        memmove(page.recordAt(index + 1), page.recordAt(index), sizeof(RecordType) * (n - index));
+        page.writeRecord(index, record);
+        page.setNumKeys(n + 1);
+    }
+
+    // Links a split child: key goes at keys[index], the new page right after children[index]
+    static void insertIntoInternal(Page& page, int index, const KeyType& key, FilePos child) {
+        int n = page.numKeys();
+        for (int i = n; i > index; i--) {
+            page.setKey(i, page.key(i - 1));
+        }
+        for (int i = n + 1; i > index + 1; i--) {
+            page.setChild(i, page.child(i - 1));
+        }
+        page.setKey(index, key);
+        page.setChild(index + 1, child);
+        page.setNumKeys(n + 1);
+    }
+
+    void insertRecord(const RecordType& record) {
+        KeyType splitKey;
+        FilePos splitPos;
+        if (insertInto(rootPos, record, splitKey, splitPos)) {
+            FilePos newRoot = allocatePage(false);
+            PinnedPage pinned(pool, pinPage(newRoot));
+            Page page = pinned.page();
+            page.setNumKeys(1);
+            page.setKey(0, splitKey);
+            page.setChild(0, rootPos);
+            page.setChild(1, splitPos);
+            pinned.dirty = true;
+            rootPos = newRoot;
+        }
+    }
+
+public:
+    // Iterator over keys in [lo, hi], ascending or (reverse) descending.
+    // Copies one leaf's matching records at a time; any mutation of the tree
+    // invalidates it.
+    class Cursor {
+    private:
+        BPlusTree* tree;
+        FilePos leafPos;
+        KeyType lo;
+        KeyType hi;
+        bool reverse;
+        vector<RecordType> buffer;
+        size_t index;
+        bool done;
+
+        // Buffers the next leaf's matching records. The first leaf starts at
+        // the bound; later ones are read from their start (or end).
+        void loadLeaf(bool first) {
+            buffer.clear();
+            index = 0;
+            while (leafPos != -1 && buffer.empty()) {
+                PinnedPage pinned(tree->pool, tree->pinPage(leafPos));
+                Page page = pinned.page();
+                bool pastEnd;
+                if (reverse) {
+                    int i = (first ? page.upperBound(hi) : page.numKeys()) - 1;
+                    for (; i >= 0 && !(page.recordKey(i) < lo); i--) {
+                        buffer.emplace_back();
+                        page.readRecord(i, buffer.back());
+                    }
+                    pastEnd = i >= 0;
+                    leafPos = pastEnd ? -1 : page.prev();
+                } else {
+                    int i = first ? page.lowerBound(lo) : 0;
+                    for (; i < page.numKeys() && !(hi < page.recordKey(i)); i++) {
+                        buffer.emplace_back();
+                        page.readRecord(i, buffer.back());
+                    }
+                    pastEnd = i < page.numKeys();
+                    leafPos = pastEnd ? -1 : page.next();
+                }
+                first = false;
+                if (buffer.empty() && pastEnd) break;
+            }
+            done = buffer.empty();
+        }
+
+    public:
+        Cursor(BPlusTree* owner, const KeyType& low, const KeyType& high, bool descending)
+            : tree(owner), lo(low), hi(high), reverse(descending), index(0), done(false) {
+            leafPos = tree->findLeaf(reverse ? hi : lo);
+            loadLeaf(true);
+        }
+
+        bool next(RecordType& out) {
+            if (done) return false;
+            if (index == buffer.size()) {
+                loadLeaf(false);
+                if (done) return false;
+            }
+            out = buffer[index++];
+            return true;
+        }
+    };
+
+    BPlusTree(const string& fname, BufferPool* bufferPool, WriteAheadLog* log = nullptr)
+        : rootPos(-1), nextPos(BPLUS_FILE_HEADER), filename(fname), pool(bufferPool), wal(log) {
+        fileId = pool->registerFile(this);
+        file.open(filename, ios::in | ios::out | ios::binary);
+
+        if (!file.is_open()) {
+            file.clear();
+            file.open(filename, ios::out | ios::binary);
+            file.close();
+            file.open(filename, ios::in | ios::out | ios::binary);
+            rootPos = allocatePage(true);
+            writeFileHeader();
+            commitPages();
+        } else {
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(&rootPos), sizeof(FilePos));
+            file.read(reinterpret_cast<char*>(&nextPos), sizeof(FilePos));
+        }
+    }
+
+    ~BPlusTree() {
+        bool durable = !wal || wal->flush();
+        pool->unregisterFile(fileId);
+        if (file.is_open()) {
+            if (durable) writeFileHeader();
+            file.close();
+        }
+    }
+
+    // Inserts, or replaces the record with the same key
+    void insert(const RecordType& record) {
+        insertRecord(record);
+        commitPages();
+    }
+
+    // Inserts a batch as a single commit, e.g. when building an index
+    void insertAll(const vector<RecordType>& records) {
+        for (const auto& record : records) {
+            insertRecord(record);
+        }
+        commitPages();
+    }
+
+    bool search(const KeyType& id, RecordType& result) {
+        PinnedPage pinned(pool, pinPage(findLeaf(id)));
+        Page page = pinned.page();
+        int index = page.lowerBound(id);
+        if (index < page.numKeys() && page.recordKey(index) == id) {
+            page.readRecord(index, result);
+            return true;
+        }
+        return false;
+    }
+
+    bool updateRecord(const KeyType& id, const RecordType& updatedRecord) {
+        bool found = false;
+        {
+            PinnedPage pinned(pool, pinPage(findLeaf(id)));
+            Page page = pinned.page();
+            int index = page.lowerBound(id);
+            if (index < page.numKeys() && page.recordKey(index) == id) {
+                page.writeRecord(index, updatedRecord);
+                pinned.dirty = true;
+                found = true;
+            }
+        }
+        if (found) commitPages();
+        return found;
+    }
+
+    bool deleteRecord(const KeyType& id) {
+        bool found = false;
+        {
+            PinnedPage pinned(pool, pinPage(findLeaf(id)));
+            Page page = pinned.page();
+            int index = page.lowerBound(id);
+            int n = page.numKeys();
+            if (index < n && page.recordKey(index) == id) {
+                memmove(page.recordAt(index), page.recordAt(index + 1), sizeof(RecordType) * (n - index - 1));
+                page.setNumKeys(n - 1);
+                pinned.dirty = true;
+                found = true;
+            }
+        }
+        if (found) commitPages();
+        return found;
+    }
+
+    // Records with lo <= key <= hi in key order
+    Cursor rangeScan(const KeyType& lo, const KeyType& hi) {
+        return Cursor(this, lo, hi, false);
+    }
+
+    // The same records, largest key first
+    Cursor reverseScan(const KeyType& lo, const KeyType& hi) {
+        return Cursor(this, lo, hi, true);
+    }
+
+    vector<RecordType> getAllRecords() {
+        vector<RecordType> records;
+        for (FilePos pos = leftmostLeaf(); pos != -1;) {
+            PinnedPage pinned(pool, pinPage(pos));
+            Page page = pinned.page();
+            size_t start = records.size();
+            records.resize(start + page.numKeys());
+            memcpy((void*)&records[start], page.recordAt(0), sizeof(RecordType) * page.numKeys());
+            pos = page.next();
+        }
+        return records;
+    }
+
+    // Same contract as BTree::forEach: key order, stops when visit returns false
+    template<typename Predicate, typename Visitor>
+    void forEach(Predicate matches, Visitor visit) {
+        RecordType record;
+        for (FilePos pos = leftmostLeaf(); pos != -1;) {
+            PinnedPage pinned(pool, pinPage(pos));
+            Page page = pinned.page();
+            for (int i = 0; i < page.numKeys(); i++) {
+                page.readRecord(i, record);
+                if (matches(record) && !visit(record)) {
+                    return;
+                }
+            }
+            pos = page.next();
+        }
+    }
+
+    template<typename Visitor>
+    void forEach(Visitor visit) {
+        forEach([](const RecordType&) { return true; }, visit);
+    }
+
+    // Walks back from the last leaf past any emptied ones; KeyType() if empty
+    KeyType getMaxId() {
+        for (FilePos pos = rightmostLeaf(); pos != -1;) {
+            PinnedPage pinned(pool, pinPage(pos));
+            Page page = pinned.page();
+            if (page.numKeys() > 0) return page.recordKey(page.numKeys() - 1);
+            pos = page.prev();
+        }
+        return KeyType();
+    }
+
+    // See BTree::checkpoint. Without a log it writes back and syncs whatever
+    // is dirty, which makes a tree built off to the side durable.
+    bool checkpoint() {
+        bool written = pool->flushFile(fileId);
+        written = writeFileHeader() && written;
+        return WriteAheadLog::syncPath(filename) && written;
+    }
+
+    void readPage(FilePos pos, char* buffer, size_t size) override {
+        lock_guard<mutex> lock(fileMutex);
+        file.seekg(pos);
+        file.read(buffer, size);
+    }
+
+    bool writePage(FilePos pos, const char* buffer, size_t size) override {
+        lock_guard<mutex> lock(fileMutex);
+        file.clear();
+        file.seekp(pos);
+        file.write(buffer, size);
+        return !file.fail();
+    }
+};
@@ -4,18 +4,28 @@
 #include <vector>
 #include <algorithm>
 #include <cstring>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include "BufferPool.h"
+#include "MappedFile.h"
 
 using namespace std;
 
 #define BTREE_ORDER 100
 
+enum StorageMode {
+    STORAGE_BUFFERED, // fstream, optionally through a BufferPool
+    STORAGE_MMAP      // shared mapping; falls back to buffered on Windows
+};
+
 template<typename RecordType>
 struct BTreeNode {
     bool isLeaf;
     int numKeys;
     RecordType keys[BTREE_ORDER - 1];
-    long children[BTREE_ORDER];
-    long nodePos;
+    FilePos children[BTREE_ORDER];
+    FilePos nodePos;
 
     BTreeNode() : isLeaf(true), numKeys(0), nodePos(-1) {
         for (int i = 0; i < BTREE_ORDER; i++) {
@@ -31,9 +41,9 @@ struct BTreeNode {
         offset += sizeof(int);
         memcpy(buffer + offset, keys, sizeof(RecordType) * (BTREE_ORDER - 1));
         offset += sizeof(RecordType) * (BTREE_ORDER - 1);
-        memcpy(buffer + offset, children, sizeof(long) * BTREE_ORDER);
-        offset += sizeof(long) * BTREE_ORDER;
-        memcpy(buffer + offset, &nodePos, sizeof(long));
+        memcpy(buffer + offset, children, sizeof(FilePos) * BTREE_ORDER);
+        offset += sizeof(FilePos) * BTREE_ORDER;
+        memcpy(buffer + offset, &nodePos, sizeof(FilePos));
     }
 
     void deserialize(const char* buffer) {
@@ -44,48 +54,222 @@ struct BTreeNode {
         offset += sizeof(int);
         memcpy(keys, buffer + offset, sizeof(RecordType) * (BTREE_ORDER - 1));
         offset += sizeof(RecordType) * (BTREE_ORDER - 1);
-        memcpy(children, buffer + offset, sizeof(long) * BTREE_ORDER);
-        offset += sizeof(long) * BTREE_ORDER;
-        memcpy(&nodePos, buffer + offset, sizeof(long));
+        memcpy(children, buffer + offset, sizeof(FilePos) * BTREE_ORDER);
+        offset += sizeof(FilePos) * BTREE_ORDER;
+        memcpy(&nodePos, buffer + offset, sizeof(FilePos));
     }
 
     static size_t getSerializedSize() {
         return sizeof(bool) + sizeof(int) + sizeof(RecordType) * (BTREE_ORDER - 1) 
-               + sizeof(long) * BTREE_ORDER + sizeof(long);
+               + sizeof(FilePos) * BTREE_ORDER + sizeof(FilePos);
     }
 };
 
+// Reads a serialized node in place. Every model keeps its int id as the first
+// field, so ids are read straight from the key bytes without copying records.
 template<typename RecordType>
-class BTree {
+struct BTreeNodeView {
+    static const size_t KEYS_OFFSET = sizeof(bool) + sizeof(int);
+    static const size_t CHILDREN_OFFSET = KEYS_OFFSET + sizeof(RecordType) * (BTREE_ORDER - 1);
+
+    const char* base;
+
+    BTreeNodeView(const char* buffer) : base(buffer) {}
+
+    bool isLeaf() const {
+        bool leaf;
+        memcpy(&leaf, base, sizeof(bool));
+        return leaf;
+    }
+
+    int numKeys() const {
+        int n;
+        memcpy(&n, base + sizeof(bool), sizeof(int));
+        return n;
+    }
+
+    int keyId(int i) const {
+        int id;
+        memcpy(&id, base + KEYS_OFFSET + sizeof(RecordType) * i, sizeof(int));
+        return id;
+    }
+
+    void copyKey(int i, RecordType& out) const {
+        memcpy(&out, base + KEYS_OFFSET + sizeof(RecordType) * i, sizeof(RecordType));
+    }
+
+    FilePos child(int i) const {
+        FilePos pos;
+        memcpy(&pos, base + CHILDREN_OFFSET + sizeof(FilePos) * i, sizeof(FilePos));
+        return pos;
+    }
+};
+
+template<typename RecordType>
+class BTree : public PageStore {
 private:
     fstream file;
-    long rootPos;
-    long nextPos;
+    FilePos rootPos;
+    FilePos nextPos;
     string filename;
-
-    long allocateNode() {
-        long pos = nextPos;
+    mutex fileMutex; // concurrent readers share one stream position
+    BufferPool* pool; // optional; nodes go straight to the file without one
+    int fileId;
+    StorageMode mode;
+    WriteAheadLog* wal; // optional; needs the pool or mmap mode to hold pages back
+#ifndef _WIN32
+    // In mmap mode readers walk nodes in place. Growing past the reservation
+    // remaps, so mutations must not run alongside readers (ServiceController's
+    // dbMutex already guarantees that).
+    MappedFile mapped;
+    vector<FilePos> unloggedPages;        // mmap + WAL: written since the last commit
+    unordered_set<FilePos> loggedPages;   // mmap + WAL: logged since the last checkpoint
+#endif
+
+    FilePos allocateNode() {
+        FilePos pos = nextPos;
         nextPos += BTreeNode<RecordType>::getSerializedSize();
         return pos;
     }
 
     void writeNode(const BTreeNode<RecordType>& node) {
+        size_t size = BTreeNode<RecordType>::getSerializedSize();
+#ifndef _WIN32
+        if (mode == STORAGE_MMAP) {
+            mapped.grow(node.nodePos + size);
+            node.serialize(mapped.data() + node.nodePos);
+            if (wal) unloggedPages.push_back(node.nodePos);
+            return;
+        }
+#endif
+        if (pool) {
+            // The whole page is overwritten, so a miss needs no disk read
+            BufferPool::Frame* frame = pool->pin(fileId, node.nodePos, size, false);
+            node.serialize(frame->data.data());
+            pool->unpin(frame, true);
+            return;
+        }
+
         char buffer[BTreeNode<RecordType>::getSerializedSize()];
         node.serialize(buffer);
-        file.seekp(node.nodePos);
-        file.write(buffer, BTreeNode<RecordType>::getSerializedSize());
+        writePage(node.nodePos, buffer, size);
+        lock_guard<mutex> lock(fileMutex);
         file.flush();
     }
 
-    BTreeNode<RecordType> readNode(long pos) {
-        char buffer[BTreeNode<RecordType>::getSerializedSize()];
-        file.seekg(pos);
-        file.read(buffer, BTreeNode<RecordType>::getSerializedSize());
+    BTreeNode<RecordType> readNode(FilePos pos) {
+        size_t size = BTreeNode<RecordType>::getSerializedSize();
         BTreeNode<RecordType> node;
+#ifndef _WIN32
+        if (mode == STORAGE_MMAP) {
+            node.deserialize(mapped.data() + pos);
+            return node;
+        }
+#endif
+        if (pool) {
+            BufferPool::Frame* frame = pool->pin(fileId, pos, size);
+            node.deserialize(frame->data.data());
+            pool->unpin(frame, false);
+            return node;
+        }
+
+        char buffer[BTreeNode<RecordType>::getSerializedSize()];
+        readPage(pos, buffer, size);
         node.deserialize(buffer);
         return node;
     }
 
+    // Ends one public mutation. With a WAL the pages it dirtied and the header
+    // go into the log as one batch; otherwise they are pushed to the file.
+    void commitPages() {
+        if (wal) {
+            logPages();
+            return;
+        }
+#ifndef _WIN32
+        if (mode == STORAGE_MMAP) {
+            writeMappedHeader();
+            mapped.sync(false);
+            return;
+        }
+#endif
+        if (!pool) return;
+        pool->flushFile(fileId);
+        lock_guard<mutex> lock(fileMutex);
+        file.flush();
+    }
+
+    void logPages() {
+        size_t size = BTreeNode<RecordType>::getSerializedSize();
+        WALBatch batch;
+        vector<BufferPool::Frame*> frames;
+#ifndef _WIN32
+        if (mode == STORAGE_MMAP) {
+            sort(unloggedPages.begin(), unloggedPages.end());
+            unloggedPages.erase(unique(unloggedPages.begin(), unloggedPages.end()), unloggedPages.end());
+            for (FilePos pos : unloggedPages) {
+                batch.addPage(filename, pos, mapped.data() + pos, size);
+                loggedPages.insert(pos);
+            }
+            unloggedPages.clear();
+            writeMappedHeader();
+        }
+#endif
+        if (mode == STORAGE_BUFFERED) {
+            frames = pool->pinUnlogged(fileId);
+            for (BufferPool::Frame* frame : frames) {
+                batch.addPage(filename, frame->pos, frame->data.data(), frame->data.size());
+            }
+        }
+        batch.addHeader(filename, rootPos, nextPos);
+        uint64_t lsn = wal->append(batch);
+        if (!frames.empty()) {
+            pool->markLogged(frames, lsn);
+        }
+    }
+
+#ifndef _WIN32
+    void writeMappedHeader() {
+        memcpy(mapped.data(), &rootPos, sizeof(FilePos));
+        memcpy(mapped.data() + sizeof(FilePos), &nextPos, sizeof(FilePos));
+    }
+
+    bool openMapped() {
+        // With a WAL the mapping is private so pages reach the file only at checkpoints
+        if (!mapped.open(filename, wal == nullptr)) return false;
+
+        if (mapped.size() < sizeof(FilePos) * 2) {
+            BTreeNode<RecordType> root;
+            root.nodePos = nextPos;
+            nextPos += BTreeNode<RecordType>::getSerializedSize();
+            rootPos = root.nodePos;
+            writeNode(root);
+            writeMappedHeader();
+            commitPages();
+        } else {
+            memcpy(&rootPos, mapped.data(), sizeof(FilePos));
+            memcpy(&nextPos, mapped.data() + sizeof(FilePos), sizeof(FilePos));
+        }
+        return true;
+    }
+
+    void collectMapped(FilePos pos, vector<RecordType>& records) {
+        BTreeNodeView<RecordType> view(mapped.data() + pos);
+        int n = view.numKeys();
+        size_t start = records.size();
+        records.resize(start + n);
+        memcpy((void*)&records[start], view.base + BTreeNodeView<RecordType>::KEYS_OFFSET, sizeof(RecordType) * n);
+
+        if (!view.isLeaf()) {
+            for (int i = 0; i <= n; i++) {
+                if (view.child(i) != -1) {
+                    collectMapped(view.child(i), records);
+                }
+            }
+        }
+    }
+#endif
+
     void splitChild(BTreeNode<RecordType>& parent, int index) {
         BTreeNode<RecordType> fullChild = readNode(parent.children[index]);
         BTreeNode<RecordType> newChild;
@@ -150,25 +334,6 @@ private:
         }
     }
 
-    bool searchNode(const BTreeNode<RecordType>& node, int id, RecordType& result) {
-        int i = 0;
-        while (i < node.numKeys && id > node.keys[i].getId()) {
-            i++;
-        }
-
-        if (i < node.numKeys && id == node.keys[i].getId()) {
-            result = node.keys[i];
-            return true;
-        }
-
-        if (node.isLeaf) {
-            return false;
-        }
-
-        BTreeNode<RecordType> child = readNode(node.children[i]);
-        return searchNode(child, id, result);
-    }
-
     void collectAllRecords(const BTreeNode<RecordType>& node, vector<RecordType>& records) {
         for (int i = 0; i < node.numKeys; i++) {
             records.push_back(node.keys[i]);
@@ -184,6 +349,77 @@ private:
         }
     }
 
+    // Calls fn with the serialized bytes of the node at pos, without copying
+    // the node when it is mapped or cached
+    template<typename Fn>
+    bool withNodeBytes(FilePos pos, Fn fn) {
+        size_t size = BTreeNode<RecordType>::getSerializedSize();
+#ifndef _WIN32
+        if (mode == STORAGE_MMAP) {
+            return fn(mapped.data() + pos);
+        }
+#endif
+        if (pool) {
+            BufferPool::Frame* frame = pool->pin(fileId, pos, size);
+            bool result = fn(frame->data.data());
+            pool->unpin(frame, false);
+            return result;
+        }
+
+        vector<char> buffer(size);
+        readPage(pos, buffer.data(), size);
+        return fn(buffer.data());
+    }
+
+    // Binary search down the nodes in place; only the matching record is copied
+    bool searchInPlace(int id, RecordType& result) {
+        FilePos pos = rootPos;
+        bool found = false;
+        while (pos != -1 && !found) {
+            FilePos next = -1;
+            withNodeBytes(pos, [&](const char* bytes) {
+                BTreeNodeView<RecordType> view(bytes);
+                int lo = 0, hi = view.numKeys();
+                while (lo < hi) {
+                    int mid = (lo + hi) / 2;
+                    if (view.keyId(mid) < id) lo = mid + 1;
+                    else hi = mid;
+                }
+                if (lo < view.numKeys() && view.keyId(lo) == id) {
+                    view.copyKey(lo, result);
+                    found = true;
+                } else if (!view.isLeaf()) {
+                    next = view.child(lo);
+                }
+                return true;
+            });
+            pos = next;
+        }
+        return found;
+    }
+
+    // In-order walk; returns false once the visitor asked to stop
+    template<typename Predicate, typename Visitor>
+    bool visitNode(FilePos pos, Predicate& matches, Visitor& visit) {
+        return withNodeBytes(pos, [&](const char* bytes) {
+            BTreeNodeView<RecordType> view(bytes);
+            bool leaf = view.isLeaf();
+            int n = view.numKeys();
+            RecordType record;
+            for (int i = 0; i <= n; i++) {
+                if (!leaf && view.child(i) != -1 && !visitNode(view.child(i), matches, visit)) {
+                    return false;
+                }
+                if (i == n) break;
+                view.copyKey(i, record);
+                if (matches(record) && !visit(record)) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
     void removeFromLeaf(BTreeNode<RecordType>& node, int idx) {
         for (int i = idx + 1; i < node.numKeys; i++) {
             node.keys[i - 1] = node.keys[i];
@@ -192,6 +428,28 @@ private:
         writeNode(node);
     }
 
+    // Removes the largest record of the subtree into out. Deletes never
+    // rebalance, so leaves may be empty; returns false if the subtree is.
+    bool takeMax(FilePos pos, RecordType& out) {
+        BTreeNode<RecordType> node = readNode(pos);
+        if (node.isLeaf) {
+            if (node.numKeys == 0) return false;
+            out = node.keys[node.numKeys - 1];
+            node.numKeys--;
+            writeNode(node);
+            return true;
+        }
+        if (takeMax(node.children[node.numKeys], out)) return true;
+        if (node.numKeys == 0) return false;
+
+        // The rightmost subtree is empty, so the last key is the maximum
+        out = node.keys[node.numKeys - 1];
+        node.children[node.numKeys] = -1;
+        node.numKeys--;
+        writeNode(node);
+        return true;
+    }
+
     bool deleteKey(BTreeNode<RecordType>& node, int id) {
         int idx = 0;
         while (idx < node.numKeys && node.keys[idx].getId() < id) {
@@ -203,6 +461,23 @@ private:
                 removeFromLeaf(node, idx);
                 return true;
             }
+            // Internal key: pull up its predecessor, or drop the key together
+            // with its left subtree when that subtree has nothing left
+            RecordType predecessor;
+            if (takeMax(node.children[idx], predecessor)) {
+                node.keys[idx] = predecessor;
+            } else {
+                for (int i = idx + 1; i < node.numKeys; i++) {
+                    node.keys[i - 1] = node.keys[i];
+                }
+                for (int i = idx + 1; i <= node.numKeys; i++) {
+                    node.children[i - 1] = node.children[i];
+                }
+                node.children[node.numKeys] = -1;
+                node.numKeys--;
+            }
+            writeNode(node);
+            return true;
         }
 
         if (node.isLeaf) {
@@ -235,7 +510,25 @@ private:
     }
 
 public:
-    BTree(const string& fname) : filename(fname), rootPos(0), nextPos(sizeof(long) * 2) {
+    BTree(const string& fname, BufferPool* bufferPool = nullptr, StorageMode storage = STORAGE_BUFFERED,
+          WriteAheadLog* log = nullptr)
+        : filename(fname), rootPos(0), nextPos(sizeof(FilePos) * 2), pool(bufferPool), fileId(-1),
+          mode(STORAGE_BUFFERED), wal(log) {
+#ifndef _WIN32
+        if (storage == STORAGE_MMAP) {
+            mode = STORAGE_MMAP;
+            if (openMapped()) {
+                return; // the mapping is the cache; the pool is not used
+            }
+            mode = STORAGE_BUFFERED;
+        }
+#endif
+        if (!pool) {
+            wal = nullptr; // direct writes cannot be held back until the log is durable
+        }
+        if (pool) {
+            fileId = pool->registerFile(this);
+        }
         file.open(filename, ios::in | ios::out | ios::binary);
         
         if (!file.is_open()) {
@@ -250,21 +543,37 @@ public:
             rootPos = root.nodePos;
             
             file.seekp(0);
-            file.write(reinterpret_cast<char*>(&rootPos), sizeof(long));
-            file.write(reinterpret_cast<char*>(&nextPos), sizeof(long));
+            file.write(reinterpret_cast<char*>(&rootPos), sizeof(FilePos));
+            file.write(reinterpret_cast<char*>(&nextPos), sizeof(FilePos));
             writeNode(root);
+            commitPages();
         } else {
             file.seekg(0);
-            file.read(reinterpret_cast<char*>(&rootPos), sizeof(long));
-            file.read(reinterpret_cast<char*>(&nextPos), sizeof(long));
+            file.read(reinterpret_cast<char*>(&rootPos), sizeof(FilePos));
+            file.read(reinterpret_cast<char*>(&nextPos), sizeof(FilePos));
         }
     }
 
     ~BTree() {
-        if (file.is_open()) {
+        // If the log failed, nothing past its durable point may reach the file
+        bool durable = !wal || wal->flush();
+        if (wal && durable) {
+            checkpoint();
+        }
+#ifndef _WIN32
+        if (mode == STORAGE_MMAP) {
+            writeMappedHeader();
+            mapped.close(nextPos);
+            return;
+        }
+#endif
+        if (pool) {
+            pool->unregisterFile(fileId);
+        }
+        if (file.is_open() && durable) {
             file.seekp(0);
-            file.write(reinterpret_cast<char*>(&rootPos), sizeof(long));
-            file.write(reinterpret_cast<char*>(&nextPos), sizeof(long));
+            file.write(reinterpret_cast<char*>(&rootPos), sizeof(FilePos));
+            file.write(reinterpret_cast<char*>(&nextPos), sizeof(FilePos));
             file.close();
         }
     }
@@ -285,20 +594,39 @@ public:
         } else {
             insertNonFull(root, record);
         }
+        commitPages();
     }
 
     bool search(int id, RecordType& result) {
-        BTreeNode<RecordType> root = readNode(rootPos);
-        return searchNode(root, id, result);
+        return searchInPlace(id, result);
     }
 
     vector<RecordType> getAllRecords() {
         vector<RecordType> records;
+#ifndef _WIN32
+        if (mode == STORAGE_MMAP) {
+            collectMapped(rootPos, records);
+            return records;
+        }
+#endif
         BTreeNode<RecordType> root = readNode(rootPos);
         collectAllRecords(root, records);
         return records;
     }
 
+    // Visits records in id order, one node at a time, without materialising
+    // the table. Records failing `matches` are skipped; the walk stops as soon
+    // as `visit` returns false.
+    template<typename Predicate, typename Visitor>
+    void forEach(Predicate matches, Visitor visit) {
+        visitNode(rootPos, matches, visit);
+    }
+
+    template<typename Visitor>
+    void forEach(Visitor visit) {
+        forEach([](const RecordType&) { return true; }, visit);
+    }
+
     int getMaxId() {
         vector<RecordType> records = getAllRecords();
         int maxId = 0;
@@ -312,11 +640,64 @@ public:
 
     bool deleteRecord(int id) {
         BTreeNode<RecordType> root = readNode(rootPos);
-        return deleteKey(root, id);
+        bool deleted = deleteKey(root, id);
+        commitPages();
+        return deleted;
     }
 
     bool updateRecord(int id, const RecordType& updatedRecord) {
         BTreeNode<RecordType> root = readNode(rootPos);
-        return updateInTree(root, id, updatedRecord);
+        bool updated = updateInTree(root, id, updatedRecord);
+        commitPages();
+        return updated;
+    }
+
+    // Writes every logged page back into the .bin file, header included, and
+    // syncs it. The log must be durable up to the last commit; the caller
+    // truncates it only if every tree's checkpoint returned true.
+    bool checkpoint() {
+        if (!wal) return true;
+#ifndef _WIN32
+        if (mode == STORAGE_MMAP) {
+            size_t size = BTreeNode<RecordType>::getSerializedSize();
+            bool written = true;
+            for (FilePos pos : loggedPages) {
+                written = mapped.writeBack(pos, size) && written;
+            }
+            written = mapped.writeBack(0, sizeof(FilePos) * 2) && written;
+            if (!written || !mapped.syncFile()) return false;
+            loggedPages.clear();
+            return true;
+        }
+#endif
+        bool written = pool->flushFile(fileId);
+        {
+            lock_guard<mutex> lock(fileMutex);
+            file.clear();
+            file.seekp(0);
+            file.write(reinterpret_cast<char*>(&rootPos), sizeof(FilePos));
+            file.write(reinterpret_cast<char*>(&nextPos), sizeof(FilePos));
+            file.flush();
+            written = !file.fail() && written;
+        }
+        return WriteAheadLog::syncPath(filename) && written;
+    }
+
+    StorageMode getStorageMode() const {
+        return mode;
+    }
+
+    void readPage(FilePos pos, char* buffer, size_t size) override {
+        lock_guard<mutex> lock(fileMutex);
+        file.seekg(pos);
+        file.read(buffer, size);
+    }
+
+    bool writePage(FilePos pos, const char* buffer, size_t size) override {
+        lock_guard<mutex> lock(fileMutex);
+        file.clear();
+        file.seekp(pos);
+        file.write(buffer, size);
+        return !file.fail();
     }
 };
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "WriteAheadLog.h"
+
+using namespace std;
+
+// Backing file for the pages of one registered file
+class PageStore {
+public:
+    virtual ~PageStore() {}
+    virtual void readPage(FilePos pos, char* buffer, size_t size) = 0;
+    // False if the page may not have reached the file
+    virtual bool writePage(FilePos pos, const char* buffer, size_t size) = 0;
+};
+
+struct BufferPoolStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t writebacks;
+    size_t pages;
+    size_t bytes;
+    size_t capacity;
+};
+
+// Page cache shared by every tree. Pages are keyed by (fileId, position) and
+// may differ in size between files; the capacity is a byte budget. Eviction
+// uses the CLOCK algorithm and skips pinned pages, so the pool can run over
+// budget while many pages are pinned. Dirty pages are written back when they
+// are evicted or when their file is flushed.
+//
+// With a write-ahead log attached a dirty page may only reach its file once
+// its log record is durable; pages of a mutation still in progress (not yet
+// logged) and pages whose record is not yet synced are skipped by eviction.
+class BufferPool {
+public:
+    struct Frame {
+        int fileId;
+        FilePos pos;
+        vector<char> data;
+        int pinCount;
+        bool dirty;
+        bool referenced;
+        bool logged;  // the current contents are in the WAL
+        uint64_t lsn; // LSN of that record
+    };
+
+private:
+    unordered_map<uint64_t, Frame*> table;
+    vector<Frame*> clock;
+    vector<PageStore*> stores; // indexed by fileId, nullptr once unregistered
+    size_t hand;
+    size_t capacity;
+    size_t usedBytes;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t writebacks;
+    WriteAheadLog* log;
+    mutex poolMutex;
+
+    static uint64_t makeKey(int fileId, FilePos pos) {
+        return ((uint64_t)(uint32_t)fileId << 32) | (uint32_t)pos;
+    }
+
+    bool canWriteBack(const Frame* frame) const {
+        return !log || (frame->logged && frame->lsn <= log->durableLsn());
+    }
+
+    // A page that failed to write stays dirty
+    bool writeBack(Frame* frame) {
+        if (!stores[frame->fileId]->writePage(frame->pos, frame->data.data(), frame->data.size())) return false;
+        frame->dirty = false;
+        writebacks++;
+        return true;
+    }
+
+    void removeFrame(size_t index) {
+        Frame* frame = clock[index];
+        table.erase(makeKey(frame->fileId, frame->pos));
+        usedBytes -= frame->data.size();
+        clock[index] = clock.back();
+        clock.pop_back();
+        delete frame;
+    }
+
+    // Evicts unpinned pages until `incoming` more bytes fit or nothing is evictable
+    void makeRoom(size_t incoming) {
+        size_t scanned = 0;
+        while (usedBytes + incoming > capacity && !clock.empty() && scanned < clock.size() * 2) {
+            if (hand >= clock.size()) hand = 0;
+            Frame* frame = clock[hand];
+            scanned++;
+            if (frame->pinCount > 0 || (frame->dirty && !canWriteBack(frame))) {
+                hand++;
+                continue;
+            }
+            if (frame->referenced) {
+                frame->referenced = false;
+                hand++;
+                continue;
+            }
+            if (frame->dirty && !writeBack(frame)) {
+                hand++;
+                continue;
+            }
+            removeFrame(hand);
+            evictions++;
+            scanned = 0;
+        }
+    }
+
+public:
+    BufferPool(size_t capacityBytes, WriteAheadLog* writeAheadLog = nullptr)
+        : hand(0), capacity(capacityBytes), usedBytes(0), hits(0), misses(0), evictions(0), writebacks(0),
+          log(writeAheadLog) {}
+
+    ~BufferPool() {
+        for (Frame* frame : clock) {
+            if (frame->dirty && stores[frame->fileId] && canWriteBack(frame)) {
+                writeBack(frame);
+            }
+            delete frame;
+        }
+    }
+
+    int registerFile(PageStore* store) {
+        lock_guard<mutex> lock(poolMutex);
+        stores.push_back(store);
+        return stores.size() - 1;
+    }
+
+    // Writes back and drops every page of the file; call before closing it.
+    // Pages whose log record never became durable are dropped unwritten.
+    void unregisterFile(int fileId) {
+        lock_guard<mutex> lock(poolMutex);
+        for (size_t i = 0; i < clock.size();) {
+            if (clock[i]->fileId == fileId) {
+                if (clock[i]->dirty && canWriteBack(clock[i])) {
+                    writeBack(clock[i]);
+                }
+                removeFrame(i);
+            } else {
+                i++;
+            }
+        }
+        stores[fileId] = nullptr;
+    }
+
+    // Returns the page pinned. With load=false a missing page is not read from
+    // disk; use it when the caller overwrites the whole page.
+    Frame* pin(int fileId, FilePos pos, size_t size, bool load = true) {
+        lock_guard<mutex> lock(poolMutex);
+        auto it = table.find(makeKey(fileId, pos));
+        if (it != table.end()) {
+            hits++;
+            it->second->pinCount++;
+            it->second->referenced = true;
+            return it->second;
+        }
+
+        misses++;
+        makeRoom(size);
+        Frame* frame = new Frame();
+        frame->fileId = fileId;
+        frame->pos = pos;
+        frame->data.resize(size);
+        frame->pinCount = 1;
+        frame->dirty = false;
+        frame->referenced = true;
+        frame->logged = false;
+        frame->lsn = 0;
+        if (load) {
+            stores[fileId]->readPage(pos, frame->data.data(), size);
+        }
+        table[makeKey(fileId, pos)] = frame;
+        clock.push_back(frame);
+        usedBytes += size;
+        return frame;
+    }
+
+    void unpin(Frame* frame, bool dirty) {
+        lock_guard<mutex> lock(poolMutex);
+        if (dirty) {
+            frame->dirty = true;
+            frame->logged = false;
+        }
+        frame->pinCount--;
+    }
+
+    // Writes back the file's dirty pages that are safe to write; they stay
+    // cached. False if any of them failed to write.
+    bool flushFile(int fileId) {
+        lock_guard<mutex> lock(poolMutex);
+        bool written = true;
+        for (Frame* frame : clock) {
+            if (frame->fileId == fileId && frame->dirty && canWriteBack(frame)) {
+                written = writeBack(frame) && written;
+            }
+        }
+        return written;
+    }
+
+    // Pins and returns the file's dirty pages that are not in the log yet
+    vector<Frame*> pinUnlogged(int fileId) {
+        lock_guard<mutex> lock(poolMutex);
+        vector<Frame*> frames;
+        for (Frame* frame : clock) {
+            if (frame->fileId == fileId && frame->dirty && !frame->logged) {
+                frame->pinCount++;
+                frames.push_back(frame);
+            }
+        }
+        return frames;
+    }
+
+    // Records that the pages were logged at `lsn` and unpins them
+    void markLogged(const vector<Frame*>& frames, uint64_t lsn) {
+        lock_guard<mutex> lock(poolMutex);
+        for (Frame* frame : frames) {
+            frame->logged = true;
+            frame->lsn = lsn;
+            frame->pinCount--;
+        }
+    }
+
+    BufferPoolStats getStats() {
+        lock_guard<mutex> lock(poolMutex);
+        BufferPoolStats stats;
+        stats.hits = hits;
+        stats.misses = misses;
+        stats.evictions = evictions;
+        stats.writebacks = writebacks;
+        stats.pages = clock.size();
+        stats.bytes = usedBytes;
+        stats.capacity = capacity;
+        return stats;
+    }
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <ostream>
+
+using namespace std;
+
+#define CSR_BLOCK_SIZE 64
+
+// One direction of a compressed-sparse-row adjacency, read in place from a
+// snapshot. Layout, all 4-byte aligned:
+//   uint32 firstEdge[nodeCount + 1]    node u's edges are [firstEdge[u], firstEdge[u + 1])
+//   uint32 firstBlock[nodeCount + 1]   node u's blocks, likewise
+//   int32  blockHead[blocks]           first neighbour of each block
+//   uint32 blockOffset[blocks + 1]     where each block's varints start in data
+//   uint8  data[]                      the rest of each block as varint deltas
+// Neighbour lists are sorted and cut into blocks of CSR_BLOCK_SIZE, so a
+// membership test is a binary search over the node's block heads plus the
+// decode of at most one block, and degrees cost O(1).
+struct CSRSection {
+    uint32_t nodeCount;
+    const uint32_t* firstEdge;
+    const uint32_t* firstBlock;
+    const int32_t* blockHead;
+    const uint32_t* blockOffset;
+    const uint8_t* data;
+
+    CSRSection()
+        : nodeCount(0), firstEdge(nullptr), firstBlock(nullptr), blockHead(nullptr), blockOffset(nullptr),
+          data(nullptr) {}
+
+    // Points the section at bytes written by CSRWriter; false if they are
+    // too short for what their own arrays claim
+    bool attach(const char* bytes, size_t length, uint32_t nodes) {
+        size_t indexBytes = sizeof(uint32_t) * (nodes + 1) * 2;
+        if (length < indexBytes) return false;
+        const uint32_t* edges = reinterpret_cast<const uint32_t*>(bytes);
+        const uint32_t* blocksStart = edges + nodes + 1;
+        uint32_t blocks = blocksStart[nodes];
+        size_t headerBytes = indexBytes + sizeof(int32_t) * blocks + sizeof(uint32_t) * (blocks + 1);
+        if (length < headerBytes) return false;
+        const int32_t* heads = reinterpret_cast<const int32_t*>(bytes + indexBytes);
+        const uint32_t* offsets = reinterpret_cast<const uint32_t*>(heads + blocks);
+        if (length < headerBytes + offsets[blocks]) return false;
+
+        nodeCount = nodes;
+        firstEdge = edges;
+        firstBlock = blocksStart;
+        blockHead = heads;
+        blockOffset = offsets;
+        data = reinterpret_cast<const uint8_t*>(bytes + headerBytes);
+        return true;
+    }
+
+    int degree(int u) const {
+        if (u < 0 || (uint32_t)u >= nodeCount) return 0;
+        return firstEdge[u + 1] - firstEdge[u];
+    }
+
+    static uint32_t readVarint(const uint8_t*& p) {
+        uint32_t value = 0;
+        int shift = 0;
+        while (*p & 0x80) {
+            value |= (uint32_t)(*p++ & 0x7F) << shift;
+            shift += 7;
+        }
+        value |= (uint32_t)(*p++) << shift;
+        return value;
+    }
+
+    // Visits the block's neighbours in order; false if visit stopped early
+    template<typename Visitor>
+    bool visitBlock(int u, uint32_t block, Visitor visit) const {
+        uint32_t index = block - firstBlock[u];
+        uint32_t count = min<uint32_t>(CSR_BLOCK_SIZE, degree(u) - index * CSR_BLOCK_SIZE);
+        int32_t value = blockHead[block];
+        if (!visit(value)) return false;
+        const uint8_t* p = data + blockOffset[block];
+        for (uint32_t i = 1; i < count; i++) {
+            value += (int32_t)readVarint(p);
+            if (!visit(value)) return false;
+        }
+        return true;
+    }
+
+    // Neighbours of u in ascending order; stops when visit returns false
+    template<typename Visitor>
+    void forEach(int u, Visitor visit) const {
+        if (degree(u) == 0) return;
+        for (uint32_t block = firstBlock[u]; block < firstBlock[u + 1]; block++) {
+            if (!visitBlock(u, block, visit)) return;
+        }
+    }
+
+    bool contains(int u, int v) const {
+        if (degree(u) == 0) return false;
+        const int32_t* first = blockHead + firstBlock[u];
+        const int32_t* last = blockHead + firstBlock[u + 1];
+        const int32_t* it = upper_bound(first, last, v);
+        if (it == first) return false;
+        bool found = false;
+        visitBlock(u, (uint32_t)(it - 1 - blockHead), [&](int32_t neighbour) {
+            found = neighbour == v;
+            return neighbour < v;
+        });
+        return found;
+    }
+};
+
+// Builds a CSRSection's bytes one node at a time, in node order
+class CSRWriter {
+private:
+    vector<uint32_t> firstEdge;
+    vector<uint32_t> firstBlock;
+    vector<int32_t> blockHead;
+    vector<uint32_t> blockOffset;
+    vector<uint8_t> data;
+
+    void writeVarint(uint32_t value) {
+        while (value >= 0x80) {
+            data.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        data.push_back((uint8_t)value);
+    }
+
+    template<typename T>
+    static void writeArray(ostream& out, const vector<T>& values) {
+        if (!values.empty()) {
+            out.write(reinterpret_cast<const char*>(values.data()), sizeof(T) * values.size());
+        }
+    }
+
+public:
+    CSRWriter() {
+        firstEdge.push_back(0);
+        firstBlock.push_back(0);
+        blockOffset.push_back(0);
+    }
+
+    // neighbours must be sorted ascending without duplicates
+    void addNode(const vector<int>& neighbours) {
+        for (size_t i = 0; i < neighbours.size(); i++) {
+            if (i % CSR_BLOCK_SIZE == 0) {
+                if (i > 0) blockOffset.push_back(data.size());
+                blockHead.push_back(neighbours[i]);
+            } else {
+                writeVarint((uint32_t)(neighbours[i] - neighbours[i - 1]));
+            }
+        }
+        if (!neighbours.empty()) blockOffset.push_back(data.size());
+        firstEdge.push_back(firstEdge.back() + neighbours.size());
+        firstBlock.push_back(blockHead.size());
+    }
+
+    // Size of the section as written, padded to 4 bytes
+    size_t byteSize() const {
+        size_t size = sizeof(uint32_t) * (firstEdge.size() + firstBlock.size() + blockOffset.size()) +
+                      sizeof(int32_t) * blockHead.size() + data.size();
+        return (size + 3) & ~(size_t)3;
+    }
+
+    void write(ostream& out) const {
+        writeArray(out, firstEdge);
+        writeArray(out, firstBlock);
+        writeArray(out, blockHead);
+        writeArray(out, blockOffset);
+        writeArray(out, data);
+        static const char padding[4] = {0, 0, 0, 0};
+        out.write(padding, (4 - data.size() % 4) % 4);
+    }
+};
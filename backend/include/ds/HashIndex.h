@@ -0,0 +1,405 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <mutex>
+#include "BufferPool.h"
+#include "WriteAheadLog.h"
+#include "BTree.h"
+#include "SecondaryIndex.h"
+
+using namespace std;
+
+#define HASH_PAGE_SIZE 4096
+#define HASH_PAGE_HEADER 8
+#define HASH_SLOTS ((HASH_PAGE_SIZE - HASH_PAGE_HEADER) / 8)
+#define HASH_INITIAL_BUCKETS 16
+#define HASH_MAGIC 0x31584948u // "HIX1"
+
+// Persistent multimap from 32-bit hashes to row ids. Page 0 holds the
+// header; buckets are a contiguous run of pages, each chaining overflow
+// pages once its slots are full. Page layout:
+//   [count:4][overflow:4] then {uint32 hash, int32 id} slots[HASH_SLOTS]
+// Pages (header included) go through the shared pool and are logged like
+// tree pages, so a lookup touches one bucket page, usually already cached.
+// The table doubles once it is three-quarters full; the old bucket run is
+// left behind in the file.
+class HashFile : public PageStore {
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t bucketCount;
+        uint32_t entries;
+        FilePos bucketsPos;
+        FilePos nextPos;
+    };
+
+    fstream file;
+    string filename;
+    mutex fileMutex;
+    BufferPool* pool;
+    int fileId;
+    WriteAheadLog* wal;
+    Header header;
+
+    struct PinnedPage {
+        BufferPool* pool;
+        BufferPool::Frame* frame;
+        bool dirty;
+
+        PinnedPage(BufferPool* p, BufferPool::Frame* f) : pool(p), frame(f), dirty(false) {}
+        ~PinnedPage() { pool->unpin(frame, dirty); }
+
+        char* data() { return frame->data.data(); }
+        int count() { int n; memcpy(&n, data(), 4); return n; }
+        void setCount(int n) { memcpy(data(), &n, 4); }
+        FilePos overflow() { FilePos pos; memcpy(&pos, data() + 4, 4); return pos; }
+        void setOverflow(FilePos pos) { memcpy(data() + 4, &pos, 4); }
+        uint32_t hashAt(int i) { uint32_t h; memcpy(&h, data() + HASH_PAGE_HEADER + i * 8, 4); return h; }
+        int32_t idAt(int i) { int32_t id; memcpy(&id, data() + HASH_PAGE_HEADER + i * 8 + 4, 4); return id; }
+        void setSlot(int i, uint32_t hash, int32_t id) {
+            memcpy(data() + HASH_PAGE_HEADER + i * 8, &hash, 4);
+            memcpy(data() + HASH_PAGE_HEADER + i * 8 + 4, &id, 4);
+        }
+    };
+
+    BufferPool::Frame* pinPage(FilePos pos) {
+        return pool->pin(fileId, pos, HASH_PAGE_SIZE);
+    }
+
+    FilePos allocatePage() {
+        FilePos pos = header.nextPos;
+        header.nextPos += HASH_PAGE_SIZE;
+        PinnedPage pinned(pool, pool->pin(fileId, pos, HASH_PAGE_SIZE, false));
+        memset(pinned.data(), 0, HASH_PAGE_SIZE);
+        pinned.setOverflow(-1);
+        pinned.dirty = true;
+        return pos;
+    }
+
+    FilePos bucketFor(uint32_t hash) const {
+        return header.bucketsPos + (FilePos)(hash & (header.bucketCount - 1)) * HASH_PAGE_SIZE;
+    }
+
+    void allocateBuckets(uint32_t count) {
+        header.bucketCount = count;
+        header.bucketsPos = header.nextPos;
+        for (uint32_t i = 0; i < count; i++) {
+            allocatePage();
+        }
+    }
+
+    void insertSlot(uint32_t hash, int32_t id) {
+        FilePos pos = bucketFor(hash);
+        while (true) {
+            PinnedPage pinned(pool, pinPage(pos));
+            int n = pinned.count();
+            if (n < HASH_SLOTS) {
+                pinned.setSlot(n, hash, id);
+                pinned.setCount(n + 1);
+                pinned.dirty = true;
+                return;
+            }
+            FilePos next = pinned.overflow();
+            if (next == -1) {
+                next = allocatePage();
+                pinned.setOverflow(next);
+                pinned.dirty = true;
+            }
+            pos = next;
+        }
+    }
+
+    // Rehashes every slot into a bucket run twice the size
+    void grow() {
+        vector<pair<uint32_t, int32_t>> slots;
+        slots.reserve(header.entries);
+        for (uint32_t b = 0; b < header.bucketCount; b++) {
+            FilePos pos = header.bucketsPos + (FilePos)b * HASH_PAGE_SIZE;
+            while (pos != -1) {
+                PinnedPage pinned(pool, pinPage(pos));
+                for (int i = 0; i < pinned.count(); i++) {
+                    slots.emplace_back(pinned.hashAt(i), pinned.idAt(i));
+                }
+                pos = pinned.overflow();
+            }
+        }
+        allocateBuckets(header.bucketCount * 2);
+        for (const auto& slot : slots) {
+            insertSlot(slot.first, slot.second);
+        }
+    }
+
+    // Ends one public mutation, as in BPlusTree::commitPages. The header
+    // rides along as page 0.
+    void commitPages() {
+        {
+            PinnedPage pinned(pool, pinPage(0));
+            memcpy(pinned.data(), &header, sizeof(Header));
+            pinned.dirty = true;
+        }
+        if (!wal) {
+            pool->flushFile(fileId);
+            lock_guard<mutex> lock(fileMutex);
+            file.flush();
+            return;
+        }
+        WALBatch batch;
+        vector<BufferPool::Frame*> frames = pool->pinUnlogged(fileId);
+        for (BufferPool::Frame* frame : frames) {
+            batch.addPage(filename, frame->pos, frame->data.data(), frame->data.size());
+        }
+        pool->markLogged(frames, wal->append(batch));
+    }
+
+public:
+    HashFile(const string& fname, BufferPool* bufferPool, WriteAheadLog* log = nullptr)
+        : filename(fname), pool(bufferPool), wal(log) {
+        fileId = pool->registerFile(this);
+        file.open(filename, ios::in | ios::out | ios::binary);
+        if (!file.is_open()) {
+            file.clear();
+            file.open(filename, ios::out | ios::binary);
+            file.close();
+            file.open(filename, ios::in | ios::out | ios::binary);
+        }
+
+        {
+            PinnedPage pinned(pool, pinPage(0));
+            memcpy(&header, pinned.data(), sizeof(Header));
+        }
+        if (header.magic != HASH_MAGIC) {
+            // New file, or one whose creation never reached the log
+            header.magic = HASH_MAGIC;
+            header.entries = 0;
+            header.nextPos = 0;
+            allocatePage();
+            allocateBuckets(HASH_INITIAL_BUCKETS);
+            commitPages();
+        }
+    }
+
+    ~HashFile() {
+        if (wal) {
+            wal->flush();
+        }
+        pool->unregisterFile(fileId);
+        if (file.is_open()) {
+            file.close();
+        }
+    }
+
+    uint32_t size() const {
+        return header.entries;
+    }
+
+    void insert(uint32_t hash, int32_t id) {
+        insertSlot(hash, id);
+        header.entries++;
+        if (header.entries > header.bucketCount * (HASH_SLOTS * 3 / 4)) {
+            grow();
+        }
+        commitPages();
+    }
+
+    // Inserts a batch as a single commit
+    void insertAll(const vector<pair<uint32_t, int32_t>>& slots) {
+        for (const auto& slot : slots) {
+            insertSlot(slot.first, slot.second);
+            header.entries++;
+            if (header.entries > header.bucketCount * (HASH_SLOTS * 3 / 4)) {
+                grow();
+            }
+        }
+        commitPages();
+    }
+
+    // Removes one (hash, id) slot; the page's last slot fills the hole
+    bool remove(uint32_t hash, int32_t id) {
+        FilePos pos = bucketFor(hash);
+        bool found = false;
+        while (pos != -1 && !found) {
+            PinnedPage pinned(pool, pinPage(pos));
+            for (int i = 0; i < pinned.count(); i++) {
+                if (pinned.hashAt(i) == hash && pinned.idAt(i) == id) {
+                    int last = pinned.count() - 1;
+                    pinned.setSlot(i, pinned.hashAt(last), pinned.idAt(last));
+                    pinned.setCount(last);
+                    pinned.dirty = true;
+                    found = true;
+                    break;
+                }
+            }
+            pos = pinned.overflow();
+        }
+        if (!found) return false;
+        // The page is unpinned (and so marked dirty) before it is logged
+        header.entries--;
+        commitPages();
+        return true;
+    }
+
+    // Ids stored under hash; stops when visit returns false
+    template<typename Visitor>
+    void forEachId(uint32_t hash, Visitor visit) {
+        FilePos pos = bucketFor(hash);
+        while (pos != -1) {
+            PinnedPage pinned(pool, pinPage(pos));
+            for (int i = 0; i < pinned.count(); i++) {
+                if (pinned.hashAt(i) == hash && !visit(pinned.idAt(i))) return;
+            }
+            pos = pinned.overflow();
+        }
+    }
+
+    // See BTree::checkpoint
+    bool checkpoint() {
+        if (!wal) return true;
+        bool written = pool->flushFile(fileId);
+        {
+            lock_guard<mutex> lock(fileMutex);
+            file.flush();
+            written = !file.fail() && written;
+        }
+        return WriteAheadLog::syncPath(filename) && written;
+    }
+
+    // Pages past the end of the file read as zeros
+    void readPage(FilePos pos, char* buffer, size_t size) override {
+        lock_guard<mutex> lock(fileMutex);
+        memset(buffer, 0, size);
+        file.clear();
+        file.seekg(pos);
+        file.read(buffer, size);
+        file.clear();
+    }
+
+    bool writePage(FilePos pos, const char* buffer, size_t size) override {
+        lock_guard<mutex> lock(fileMutex);
+        file.clear();
+        file.seekp(pos);
+        file.write(buffer, size);
+        return !file.fail();
+    }
+};
+
+// Case-insensitive index on a fixed-size char field, e.g. User::username.
+// Keys are hashed (djb2 over the lowercased bytes) into a HashFile; lookups
+// read the few rows under the hash and compare the field itself, so hash
+// collisions cost a row read, never a wrong match. Empty fields are not
+// indexed. Duplicates that predate the index stay reachable.
+template<typename RecordType, size_t FieldSize>
+class HashIndex : public RecordIndex<RecordType> {
+private:
+    HashFile* hashFile;
+    BTree<RecordType>* table;
+    char (RecordType::*field)[FieldSize];
+    bool unique;
+
+    static size_t keyLength(const char* key, size_t limit) {
+        size_t length = 0;
+        while (length < limit && key[length]) length++;
+        return length;
+    }
+
+    static uint32_t hashKey(const char* key, size_t limit) {
+        uint32_t hash = 5381;
+        for (size_t i = 0; i < limit && key[i]; i++) {
+            hash = ((hash << 5) + hash) + (uint32_t)tolower((unsigned char)key[i]);
+        }
+        return hash;
+    }
+
+    static bool sameKey(const char* a, size_t aLimit, const char* b, size_t bLimit) {
+        size_t length = keyLength(a, aLimit);
+        if (keyLength(b, bLimit) != length) return false;
+        for (size_t i = 0; i < length; i++) {
+            if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+        }
+        return true;
+    }
+
+    const char* keyOf(const RecordType& record) const {
+        return record.*field;
+    }
+
+public:
+    HashIndex(const string& fname, char (RecordType::*indexedField)[FieldSize], bool isUnique,
+              BTree<RecordType>* indexedTable, BufferPool* pool, WriteAheadLog* wal)
+        : table(indexedTable), field(indexedField), unique(isUnique) {
+        hashFile = new HashFile(fname, pool, wal);
+    }
+
+    ~HashIndex() {
+        delete hashFile;
+    }
+
+    void add(const RecordType& record) override {
+        if (keyOf(record)[0] == '\0') return;
+        hashFile->insert(hashKey(keyOf(record), FieldSize), record.getId());
+    }
+
+    void remove(const RecordType& record) override {
+        if (keyOf(record)[0] == '\0') return;
+        hashFile->remove(hashKey(keyOf(record), FieldSize), record.getId());
+    }
+
+    bool sameEntry(const RecordType& a, const RecordType& b) const override {
+        return a.getId() == b.getId() && sameKey(keyOf(a), FieldSize, keyOf(b), FieldSize);
+    }
+
+    bool conflicts(const RecordType& record) override {
+        if (!unique || keyOf(record)[0] == '\0') return false;
+        bool found = false;
+        forEachMatch(keyOf(record), [&](const RecordType& match) {
+            found = match.getId() != record.getId();
+            return !found;
+        });
+        return found;
+    }
+
+    bool isEmpty() override {
+        return hashFile->size() == 0;
+    }
+
+    vector<int> build(const vector<RecordType>& records) override {
+        vector<pair<uint32_t, int32_t>> slots;
+        slots.reserve(records.size());
+        for (const auto& record : records) {
+            if (keyOf(record)[0] != '\0') {
+                slots.emplace_back(hashKey(keyOf(record), FieldSize), record.getId());
+            }
+        }
+        hashFile->insertAll(slots);
+        return vector<int>();
+    }
+
+    // Rows whose field equals key, ignoring case; stops when visit returns false
+    template<typename Visitor>
+    void forEachMatch(const char* key, Visitor visit) {
+        size_t limit = strlen(key);
+        if (limit == 0) return;
+        hashFile->forEachId(hashKey(key, limit), [&](int32_t id) {
+            RecordType record;
+            if (!table->search(id, record) || !sameKey(keyOf(record), FieldSize, key, limit)) return true;
+            return visit(record);
+        });
+    }
+
+    bool contains(const char* key) {
+        bool found = false;
+        forEachMatch(key, [&](const RecordType&) {
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+    bool checkpoint() override {
+        return hashFile->checkpoint();
+    }
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+#define BM25_K1 1.2f
+#define BM25_B 0.75f
+
+// Writes the ids present in both sorted lists to out, in order. With SSE2
+// four ids of a are compared against four of b (in all four rotations) at
+// once; the scalar merge finishes the tails.
+inline void intersectSorted(const vector<int>& a, const vector<int>& b, vector<int>& out) {
+    out.clear();
+    size_t i = 0, j = 0;
+#if defined(__SSE2__)
+    while (i + 4 <= a.size() && j + 4 <= b.size()) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + j));
+        __m128i hits = _mm_cmpeq_epi32(va, vb);
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+        int mask = _mm_movemask_epi8(hits);
+        for (int lane = 0; lane < 4; lane++) {
+            if (mask & (1 << (lane * 4))) out.push_back(a[i + lane]);
+        }
+        int lastA = a[i + 3], lastB = b[j + 3];
+        if (lastA <= lastB) i += 4;
+        if (lastB <= lastA) j += 4;
+    }
+#endif
+    while (i < a.size() && j < b.size()) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            out.push_back(a[i]);
+            i++;
+            j++;
+        }
+    }
+}
+
+// Tokenised full-text index with BM25 ranking. Tokens are lower-cased runs
+// of letters and digits, two or more long. Each term's postings are
+// (doc id delta, term frequency) varint pairs in ascending doc order, so
+// adding a document with a new highest id only appends.
+class InvertedIndex {
+private:
+    struct Postings {
+        vector<uint8_t> bytes;
+        uint32_t docs;
+        int lastDoc;
+    };
+
+    unordered_map<string, Postings> terms;
+    unordered_map<int, uint32_t> docLengths;
+    uint64_t totalLength;
+
+    static void writeVarint(vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    static uint32_t readVarint(const uint8_t*& p) {
+        uint32_t value = 0;
+        int shift = 0;
+        while (*p & 0x80) {
+            value |= (uint32_t)(*p++ & 0x7F) << shift;
+            shift += 7;
+        }
+        value |= (uint32_t)(*p++) << shift;
+        return value;
+    }
+
+    static void decode(const Postings& postings, vector<int>& docs, vector<uint32_t>& freqs) {
+        docs.clear();
+        freqs.clear();
+        const uint8_t* p = postings.bytes.data();
+        int doc = 0;
+        for (uint32_t i = 0; i < postings.docs; i++) {
+            doc += (int)readVarint(p);
+            docs.push_back(doc);
+            freqs.push_back(readVarint(p));
+        }
+    }
+
+    static void encode(Postings& postings, const vector<int>& docs, const vector<uint32_t>& freqs) {
+        postings.bytes.clear();
+        int previous = 0;
+        for (size_t i = 0; i < docs.size(); i++) {
+            writeVarint(postings.bytes, docs[i] - previous);
+            writeVarint(postings.bytes, freqs[i]);
+            previous = docs[i];
+        }
+        postings.docs = docs.size();
+        postings.lastDoc = docs.empty() ? 0 : docs.back();
+    }
+
+    // Term frequencies of a text
+    static unordered_map<string, uint32_t> countTokens(const string& text, uint32_t& length) {
+        unordered_map<string, uint32_t> counts;
+        length = 0;
+        for (const string& token : tokenize(text)) {
+            counts[token]++;
+            length++;
+        }
+        return counts;
+    }
+
+public:
+    InvertedIndex() : totalLength(0) {}
+
+    static vector<string> tokenize(const string& text) {
+        vector<string> tokens;
+        string token;
+        for (size_t i = 0; i <= text.size(); i++) {
+            unsigned char c = i < text.size() ? text[i] : ' ';
+            if (isalnum(c)) {
+                token += (char)tolower(c);
+            } else {
+                if (token.size() >= 2) tokens.push_back(token);
+                token.clear();
+            }
+        }
+        return tokens;
+    }
+
+    // Document ids must be positive and not already indexed
+    void add(int docId, const string& text) {
+        uint32_t length;
+        unordered_map<string, uint32_t> counts = countTokens(text, length);
+        docLengths[docId] = length;
+        totalLength += length;
+
+        vector<int> docs;
+        vector<uint32_t> freqs;
+        for (const auto& term : counts) {
+            auto it = terms.find(term.first);
+            if (it == terms.end()) {
+                it = terms.emplace(term.first, Postings{vector<uint8_t>(), 0, 0}).first;
+            }
+            Postings& postings = it->second;
+            if (postings.docs == 0 || docId > postings.lastDoc) {
+                writeVarint(postings.bytes, docId - postings.lastDoc);
+                writeVarint(postings.bytes, term.second);
+                postings.docs++;
+                postings.lastDoc = docId;
+            } else {
+                decode(postings, docs, freqs);
+                size_t pos = lower_bound(docs.begin(), docs.end(), docId) - docs.begin();
+                docs.insert(docs.begin() + pos, docId);
+                freqs.insert(freqs.begin() + pos, term.second);
+                encode(postings, docs, freqs);
+            }
+        }
+    }
+
+    // text must be what the document was added with
+    void remove(int docId, const string& text) {
+        auto length = docLengths.find(docId);
+        if (length == docLengths.end()) return;
+        totalLength -= length->second;
+        docLengths.erase(length);
+
+        uint32_t ignored;
+        vector<int> docs;
+        vector<uint32_t> freqs;
+        for (const auto& term : countTokens(text, ignored)) {
+            auto it = terms.find(term.first);
+            if (it == terms.end()) continue;
+            decode(it->second, docs, freqs);
+            size_t pos = lower_bound(docs.begin(), docs.end(), docId) - docs.begin();
+            if (pos == docs.size() || docs[pos] != docId) continue;
+            docs.erase(docs.begin() + pos);
+            freqs.erase(freqs.begin() + pos);
+            if (docs.empty()) {
+                terms.erase(it);
+            } else {
+                encode(it->second, docs, freqs);
+            }
+        }
+    }
+
+    // Documents containing every query term, best BM25 score first; pairs
+    // are (doc id, score). Read-only, so callers may share the index.
+    vector<pair<int, float>> search(const string& query, size_t k) const {
+        vector<string> queryTerms = tokenize(query);
+        sort(queryTerms.begin(), queryTerms.end());
+        queryTerms.erase(unique(queryTerms.begin(), queryTerms.end()), queryTerms.end());
+        if (queryTerms.empty() || docLengths.empty()) return vector<pair<int, float>>();
+
+        vector<const Postings*> lists;
+        for (const string& term : queryTerms) {
+            auto it = terms.find(term);
+            if (it == terms.end()) return vector<pair<int, float>>();
+            lists.push_back(&it->second);
+        }
+        // Rarest first keeps the running intersection short
+        sort(lists.begin(), lists.end(), [](const Postings* a, const Postings* b) { return a->docs < b->docs; });
+
+        vector<vector<int>> docs(lists.size());
+        vector<vector<uint32_t>> freqs(lists.size());
+        for (size_t t = 0; t < lists.size(); t++) {
+            decode(*lists[t], docs[t], freqs[t]);
+        }
+        vector<int> matches = docs[0];
+        vector<int> narrowed;
+        for (size_t t = 1; t < lists.size() && !matches.empty(); t++) {
+            intersectSorted(matches, docs[t], narrowed);
+            matches.swap(narrowed);
+        }
+
+        double docCount = docLengths.size();
+        double averageLength = (double)totalLength / docCount;
+        vector<pair<int, float>> results;
+        for (int doc : matches) {
+            results.push_back({doc, 0.0f});
+        }
+        for (size_t t = 0; t < lists.size(); t++) {
+            double df = lists[t]->docs;
+            double idf = log(1.0 + (docCount - df + 0.5) / (df + 0.5));
+            size_t p = 0;
+            for (auto& result : results) {
+                while (docs[t][p] < result.first) p++;
+                double tf = freqs[t][p];
+                double norm = BM25_K1 * (1.0 - BM25_B + BM25_B * docLengths.find(result.first)->second / averageLength);
+                result.second += (float)(idf * tf * (BM25_K1 + 1.0) / (tf + norm));
+            }
+        }
+
+        size_t kept = min(k, results.size());
+        partial_sort(results.begin(), results.begin() + kept, results.end(),
+                     [](const pair<int, float>& a, const pair<int, float>& b) {
+                         if (a.second != b.second) return a.second > b.second;
+                         return a.first < b.first;
+                     });
+        results.resize(kept);
+        return results;
+    }
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+
+// Address space reserved per mapping so the file can grow in place
+#define MMAP_RESERVE_SIZE ((size_t)1 << 30)
+#define MMAP_GROW_CHUNK (1024 * 1024)
+
+// Read/write shared mapping of a whole file. The mapping covers more address
+// space than the file, and growing only extends the file with ftruncate, so
+// pointers into the mapping stay valid. Only when the reservation runs out is
+// the file remapped, which moves it; the caller must hold off readers then.
+//
+// A private mapping keeps writes in memory (copy-on-write); they only reach
+// the file through writeBack(). A write-ahead log needs that to control when
+// pages hit the disk.
+class MappedFile {
+private:
+    int fd;
+    char* base;
+    size_t fileSize;
+    size_t reserved;
+    bool shared;
+
+    static size_t roundUp(size_t value, size_t unit) {
+        return (value + unit - 1) / unit * unit;
+    }
+
+    bool map(size_t length) {
+        void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        base = (char*)addr;
+        reserved = length;
+        return true;
+    }
+
+public:
+    MappedFile() : fd(-1), base(nullptr), fileSize(0), reserved(0), shared(true) {}
+
+    ~MappedFile() {
+        if (fd >= 0) {
+            close(fileSize);
+        }
+    }
+
+    bool open(const string& path, bool sharedMapping = true) {
+        shared = sharedMapping;
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        fileSize = st.st_size;
+
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t wanted = roundUp(fileSize * 2 > MMAP_RESERVE_SIZE ? fileSize * 2 : MMAP_RESERVE_SIZE, page);
+        // Small address spaces may refuse the reservation; map just the file then
+        if (!map(wanted) && !map(roundUp(fileSize > 0 ? fileSize : page, page))) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    char* data() const {
+        return base;
+    }
+
+    size_t size() const {
+        return fileSize;
+    }
+
+    // Extends the file to at least minSize bytes
+    bool grow(size_t minSize) {
+        if (minSize <= fileSize) return true;
+
+        size_t newSize = roundUp(minSize > fileSize + fileSize / 2 ? minSize : fileSize + fileSize / 2, MMAP_GROW_CHUNK);
+        if (ftruncate(fd, newSize) != 0) return false;
+
+        if (newSize > reserved) {
+            // A private mapping loses its unsaved pages on remap, so keep them
+            vector<char> saved;
+            if (!shared) saved.assign(base, base + fileSize);
+            munmap(base, reserved);
+            if (!map(roundUp(newSize * 2, sysconf(_SC_PAGESIZE)))) {
+                return false;
+            }
+            if (!shared) memcpy(base, saved.data(), saved.size());
+        }
+        fileSize = newSize;
+        return true;
+    }
+
+    // MS_ASYNC schedules write-back; wait=true blocks until it is on disk
+    void sync(bool wait) {
+        if (fileSize > 0) {
+            msync(base, fileSize, wait ? MS_SYNC : MS_ASYNC);
+        }
+    }
+
+    // Copies a range of a private mapping into the file
+    bool writeBack(size_t offset, size_t length) {
+        const char* data = base + offset;
+        while (length > 0) {
+            ssize_t n = pwrite(fd, data, length, offset);
+            if (n <= 0) return false;
+            data += n;
+            offset += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    bool syncFile() {
+        return fdatasync(fd) == 0;
+    }
+
+    // Syncs, unmaps and trims the growth slack off the end of the file
+    bool close(size_t finalSize) {
+        sync(true);
+        munmap(base, reserved);
+        bool trimmed = ftruncate(fd, finalSize) == 0;
+        ::close(fd);
+        fd = -1;
+        base = nullptr;
+        fileSize = 0;
+        reserved = 0;
+        return trimmed;
+    }
+};
+
+#endif
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <initializer_list>
+#include <cstdint>
+#include <climits>
+#include "BTree.h"
+#include "BPlusTree.h"
+
+using namespace std;
+
+// Entry of an index on N int fields: the field values, then the row id,
+// e.g. (user_id, log_id). Entries are ordered field by field, then by id, so
+// rows sharing a prefix of the fields sit next to each other in the leaves.
+// The entry is its own B+tree key.
+template<int N>
+struct IndexKey {
+    int32_t parts[N];
+    int32_t id;
+
+    IndexKey() : id(0) {
+        for (int i = 0; i < N; i++) parts[i] = 0;
+    }
+
+    bool sameParts(const IndexKey& other) const {
+        for (int i = 0; i < N; i++) {
+            if (parts[i] != other.parts[i]) return false;
+        }
+        return true;
+    }
+
+    bool operator<(const IndexKey& other) const {
+        for (int i = 0; i < N; i++) {
+            if (parts[i] != other.parts[i]) return parts[i] < other.parts[i];
+        }
+        return id < other.id;
+    }
+
+    bool operator==(const IndexKey& other) const {
+        return sameParts(other) && id == other.id;
+    }
+};
+
+// What IndexedBTree needs from an index, whatever its width
+template<typename RecordType>
+class RecordIndex {
+public:
+    virtual ~RecordIndex() {}
+    virtual void add(const RecordType& record) = 0;
+    virtual void remove(const RecordType& record) = 0;
+    virtual bool sameEntry(const RecordType& a, const RecordType& b) const = 0;
+    // A unique index already holds the record's fields under another id
+    virtual bool conflicts(const RecordType& record) = 0;
+    virtual bool isEmpty() = 0;
+    // Fills an empty index as one commit; returns the ids a unique index
+    // had to leave out because an earlier row has the same fields
+    virtual vector<int> build(const vector<RecordType>& records) = 0;
+    virtual bool checkpoint() = 0;
+};
+
+// Persistent index over N int fields of a table, stored as a B+tree in the
+// shared pool and logged like any other tree.
+template<typename RecordType, int N = 1>
+class SecondaryIndex : public RecordIndex<RecordType> {
+private:
+    typedef IndexKey<N> Entry;
+
+    BPlusTree<Entry, Entry>* tree;
+    int RecordType::*fields[N];
+    bool unique;
+
+    // Smallest (fill = INT32_MIN) or largest (INT32_MAX) entry under a
+    // prefix, optionally followed by one more field value
+    static Entry bound(initializer_list<int> prefix, const int32_t* next, int32_t fill) {
+        Entry entry;
+        int i = 0;
+        for (int value : prefix) {
+            if (i < N) entry.parts[i++] = value;
+        }
+        if (next && i < N) {
+            entry.parts[i++] = *next;
+        }
+        for (; i < N; i++) {
+            entry.parts[i] = fill;
+        }
+        entry.id = fill;
+        return entry;
+    }
+
+    template<typename Visitor>
+    void scan(const Entry& lo, const Entry& hi, Visitor visit, bool descending = false) {
+        auto cursor = descending ? tree->reverseScan(lo, hi) : tree->rangeScan(lo, hi);
+        Entry entry;
+        while (cursor.next(entry)) {
+            if (!visit(entry)) return;
+        }
+    }
+
+public:
+    SecondaryIndex(const string& fname, int RecordType::* const (&indexedFields)[N], bool isUnique,
+                   BufferPool* pool, WriteAheadLog* wal)
+        : unique(isUnique) {
+        for (int i = 0; i < N; i++) {
+            fields[i] = indexedFields[i];
+        }
+        tree = new BPlusTree<Entry, Entry>(fname, pool, wal);
+    }
+
+    ~SecondaryIndex() {
+        delete tree;
+    }
+
+    Entry entryFor(const RecordType& record) const {
+        Entry entry;
+        for (int i = 0; i < N; i++) {
+            entry.parts[i] = record.*fields[i];
+        }
+        entry.id = record.getId();
+        return entry;
+    }
+
+    void add(const RecordType& record) override {
+        tree->insert(entryFor(record));
+    }
+
+    void remove(const RecordType& record) override {
+        tree->deleteRecord(entryFor(record));
+    }
+
+    bool sameEntry(const RecordType& a, const RecordType& b) const override {
+        return entryFor(a) == entryFor(b);
+    }
+
+    bool conflicts(const RecordType& record) override {
+        if (!unique) return false;
+        Entry entry = entryFor(record);
+        Entry lo = entry, hi = entry;
+        lo.id = INT32_MIN;
+        hi.id = INT32_MAX;
+        bool found = false;
+        scan(lo, hi, [&](const Entry& match) {
+            found = match.id != entry.id;
+            return !found;
+        });
+        return found;
+    }
+
+    bool isEmpty() override {
+        bool empty = true;
+        tree->forEach([&](const Entry&) {
+            empty = false;
+            return false;
+        });
+        return empty;
+    }
+
+    vector<int> build(const vector<RecordType>& records) override {
+        vector<Entry> entries;
+        vector<int> rejected;
+        entries.reserve(records.size());
+        for (const auto& record : records) {
+            entries.push_back(entryFor(record));
+        }
+        sort(entries.begin(), entries.end());
+        if (unique) {
+            // Keep the lowest id of each run of equal fields
+            size_t kept = 0;
+            for (size_t i = 0; i < entries.size(); i++) {
+                if (kept > 0 && entries[kept - 1].sameParts(entries[i])) {
+                    rejected.push_back(entries[i].id);
+                } else {
+                    entries[kept++] = entries[i];
+                }
+            }
+            entries.resize(kept);
+        }
+        tree->insertAll(entries);
+        return rejected;
+    }
+
+    // Entries whose leading fields equal prefix, in index order (remaining
+    // fields, then id); stops when visit returns false. The entry carries
+    // the indexed fields, so callers needing only those skip the table.
+    template<typename Visitor>
+    void forEachEntry(initializer_list<int> prefix, Visitor visit, bool descending = false) {
+        scan(bound(prefix, nullptr, INT32_MIN), bound(prefix, nullptr, INT32_MAX), visit, descending);
+    }
+
+    // Entries under prefix whose next field lies in [from, to), e.g. one
+    // user's logs between two dates
+    template<typename Visitor>
+    void forEachEntryInRange(initializer_list<int> prefix, int32_t from, int32_t to, Visitor visit,
+                             bool descending = false) {
+        if (from >= to) return;
+        int32_t last = to - 1;
+        scan(bound(prefix, &from, INT32_MIN), bound(prefix, &last, INT32_MAX), visit, descending);
+    }
+
+    template<typename Visitor>
+    void forEachId(initializer_list<int> prefix, Visitor visit) {
+        forEachEntry(prefix, [&](const Entry& entry) { return visit(entry.id); });
+    }
+
+    // First id stored under the full set of fields
+    bool findId(initializer_list<int> key, int& id) {
+        bool found = false;
+        forEachId(key, [&](int match) {
+            id = match;
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+    bool checkpoint() override {
+        return tree->checkpoint();
+    }
+};
+
+// BTree that keeps secondary indexes on some of its int fields in step with
+// every insert, update and delete. Under a WAL transaction the row and its
+// index entries commit together. Lookups by an indexed field cost one range
+// scan plus one primary search per match instead of a full table scan.
+template<typename RecordType>
+class IndexedBTree : public BTree<RecordType> {
+private:
+    typedef BTree<RecordType> Base;
+
+    BufferPool* pool;
+    WriteAheadLog* wal;
+    vector<RecordIndex<RecordType>*> indexes;
+
+    bool conflicts(const RecordType& record) {
+        for (auto* index : indexes) {
+            if (index->conflicts(record)) return true;
+        }
+        return false;
+    }
+
+    // Fills an empty index from the table. Rows a unique index rejects are
+    // duplicates left by older builds and are deleted from the table.
+    void buildIndex(RecordIndex<RecordType>* index, const string& fname) {
+        vector<RecordType> records = Base::getAllRecords();
+        if (records.empty()) return;
+
+        vector<int> rejected = index->build(records);
+        for (int id : rejected) {
+            deleteRecord(id);
+        }
+        cout << "Built index " << fname << " with " << records.size() - rejected.size() << " entries";
+        if (!rejected.empty()) {
+            cout << ", removed " << rejected.size() << " duplicate rows";
+        }
+        cout << endl;
+    }
+
+public:
+    IndexedBTree(const string& fname, BufferPool* bufferPool, StorageMode storage = STORAGE_BUFFERED,
+                 WriteAheadLog* log = nullptr)
+        : Base(fname, bufferPool, storage, log), pool(bufferPool), wal(log) {}
+
+    ~IndexedBTree() {
+        for (auto* index : indexes) {
+            delete index;
+        }
+    }
+
+    // Opens (or creates) an index on the given fields, e.g.
+    //   addIndex("data/logs_by_user.idx", {&Log::user_id})
+    // An empty index over a non-empty table is built from the table; a crash
+    // mid-build leaves it empty again. A unique index refuses rows whose
+    // fields another row already has.
+    template<int N>
+    SecondaryIndex<RecordType, N>* addIndex(const string& fname, int RecordType::* const (&fields)[N],
+                                            bool unique = false) {
+        return attachIndex(new SecondaryIndex<RecordType, N>(fname, fields, unique, pool, wal), fname);
+    }
+
+    // Takes ownership of an index of another kind (e.g. a HashIndex) stored
+    // in fname, building it the same way
+    template<typename Index>
+    Index* attachIndex(Index* index, const string& fname) {
+        indexes.push_back(index);
+        if (index->isEmpty()) {
+            buildIndex(index, fname);
+        }
+        return index;
+    }
+
+    // False (and nothing written) if a unique index already has the fields
+    bool insert(const RecordType& record) {
+        if (conflicts(record)) return false;
+        Base::insert(record);
+        for (auto* index : indexes) {
+            index->add(record);
+        }
+        return true;
+    }
+
+    bool updateRecord(int id, const RecordType& updatedRecord) {
+        RecordType old;
+        if (!Base::search(id, old) || conflicts(updatedRecord) || !Base::updateRecord(id, updatedRecord)) {
+            return false;
+        }
+        for (auto* index : indexes) {
+            if (!index->sameEntry(old, updatedRecord)) {
+                index->remove(old);
+                index->add(updatedRecord);
+            }
+        }
+        return true;
+    }
+
+    bool deleteRecord(int id) {
+        RecordType old;
+        if (!Base::search(id, old) || !Base::deleteRecord(id)) {
+            return false;
+        }
+        for (auto* index : indexes) {
+            index->remove(old);
+        }
+        return true;
+    }
+
+    // Rows whose leading indexed fields equal prefix, in index order; stops
+    // when visit returns false
+    template<int N, typename Visitor>
+    void forEachWhere(SecondaryIndex<RecordType, N>* index, initializer_list<int> prefix, Visitor visit) {
+        index->forEachId(prefix, [&](int id) {
+            RecordType record;
+            return !Base::search(id, record) || visit(record);
+        });
+    }
+
+    // Rows under prefix whose next indexed field lies in [from, to), in index
+    // order or reversed (e.g. newest first on a date field)
+    template<int N, typename Visitor>
+    void forEachInRange(SecondaryIndex<RecordType, N>* index, initializer_list<int> prefix, int32_t from,
+                        int32_t to, bool descending, Visitor visit) {
+        index->forEachEntryInRange(prefix, from, to, [&](const IndexKey<N>& entry) {
+            RecordType record;
+            return !Base::search(entry.id, record) || visit(record);
+        }, descending);
+    }
+
+    bool checkpoint() {
+        bool written = Base::checkpoint();
+        for (auto* index : indexes) {
+            written = index->checkpoint() && written;
+        }
+        return written;
+    }
+};
@@ -4,161 +4,606 @@
 #include <vector>
 #include <fstream>
 #include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CSRGraph.h"
+#include "MappedFile.h"
+#include "WriteAheadLog.h"
 
 using namespace std;
 
-// Social Graph using Adjacency List for directed follows
+#define SOCIAL_GRAPH_MAGIC 0x47534C43 // "CLSG"
+#define SOCIAL_GRAPH_VERSION 3
+
+// Journal records before a background compaction
+#ifndef SOCIAL_JOURNAL_LIMIT
+#define SOCIAL_JOURNAL_LIMIT 4096
+#endif
+
+// Social graph of directed follows.
+//
+// The bulk of the graph is an immutable snapshot (social.bin) with two CSR
+// sections, following and followers, mapped in one go and read in place. A
+// small delta layer on top holds, per user and direction, the sorted ids
+// added and removed since the snapshot. Counts are O(1), isFollowing is a
+// binary search in each layer, and lists come out sorted by user id.
+//
+// Follows and unfollows are also appended to a journal of fixed-size records
+// (social.bin.journal). Once it reaches SOCIAL_JOURNAL_LIMIT records it is
+// rotated to social.bin.journal.old and a background thread merges the
+// snapshot with a copy of the delta into a new snapshot, then drops the
+// rotated journal. The next mutation maps the new snapshot and rebases the
+// delta onto it. Loading replays both journals over the snapshot; replaying
+// records the snapshot already holds is harmless since follow and unfollow
+// are idempotent.
+//
+// The journal is as durable as the tables: waitJournal() fdatasyncs it with
+// one leader per group of waiters, like WriteAheadLog::waitDurable, and the
+// service waits on it before answering a write. A journal that failed to
+// write or sync stays failed.
 class SocialGraph {
 private:
-    unordered_map<int, vector<int>> adjacencyList; // userId -> list of followed userIds
-    string filename;
+    struct DeltaList {
+        vector<int> added;   // sorted, not in the snapshot
+        vector<int> removed; // sorted, in the snapshot
+    };
+
+    typedef unordered_map<int, DeltaList> DeltaMap;
 
+    // Version 1 files start straight with {totalUsers, totalConnections} and
+    // hold out-edges only; version 2 puts {magic, version} in front and an
+    // in-edge list after each out-edge list
     struct GraphHeader {
-        int totalUsers;
-        int totalConnections;
+        uint32_t magic;
+        uint32_t version;
+        uint32_t nodeCount;
+        uint32_t totalConnections;
+        uint32_t followingOffset;
+        uint32_t followingLength;
+        uint32_t followersOffset;
+        uint32_t followersLength;
     };
 
-public:
-    SocialGraph(const string& file) : filename(file) {
-        loadFromDisk();
+    struct Snapshot {
+#ifndef _WIN32
+        MappedFile mapped;
+#else
+        vector<char> bytes;
+#endif
+        GraphHeader header;
+        CSRSection following;
+        CSRSection followers;
+    };
+
+    enum JournalOp {
+        JOURNAL_FOLLOW = 1,
+        JOURNAL_UNFOLLOW = 2
+    };
+
+    struct JournalRecord {
+        int op;
+        int followerId;
+        int targetId;
+    };
+
+    Snapshot* base;
+    CSRSection emptySection;
+    DeltaMap followingDelta;
+    DeltaMap followersDelta;
+    string filename;
+    int totalConnections;
+    int userBound;    // one past the largest id on any edge
+
+    ofstream journal;
+    int journalRecords;
+
+    // Journal group commit; records are counted from 0 for the process
+    mutex syncMutex;
+    condition_variable journalSynced;
+    uint64_t journalAppended;
+    uint64_t journalDurable;
+    bool journalSyncing;
+    bool journalFailed;
+
+    // Compaction hands the current snapshot and a copy of the delta to the
+    // compactor thread; `compacted` means a new snapshot awaits installing
+    thread compactor;
+    mutex compactMutex;
+    condition_variable compactReady;
+    DeltaMap* frozenFollowing;
+    DeltaMap* frozenFollowers;
+    int frozenConnections;
+    bool jobPending;
+    bool compacting;
+    bool compacted;
+    bool stopping;
+
+    string journalPath() const { return filename + ".journal"; }
+    string rotatedJournalPath() const { return filename + ".journal.old"; }
+
+    const CSRSection& baseFollowing() const { return base ? base->following : emptySection; }
+    const CSRSection& baseFollowers() const { return base ? base->followers : emptySection; }
+
+    // Maps a version 3 snapshot; nullptr if it is missing or in another format
+    static Snapshot* openSnapshot(const string& path) {
+        ifstream probe(path, ios::binary);
+        GraphHeader header;
+        if (!probe.read(reinterpret_cast<char*>(&header), sizeof(GraphHeader)) ||
+            header.magic != SOCIAL_GRAPH_MAGIC || header.version != SOCIAL_GRAPH_VERSION) {
+            return nullptr;
+        }
+        probe.close();
+
+        Snapshot* snapshot = new Snapshot();
+#ifndef _WIN32
+        if (!snapshot->mapped.open(path)) {
+            delete snapshot;
+            return nullptr;
+        }
+        const char* bytes = snapshot->mapped.data();
+        size_t size = snapshot->mapped.size();
+#else
+        ifstream file(path, ios::binary | ios::ate);
+        snapshot->bytes.resize(file.tellg());
+        file.seekg(0);
+        file.read(snapshot->bytes.data(), snapshot->bytes.size());
+        const char* bytes = snapshot->bytes.data();
+        size_t size = snapshot->bytes.size();
+#endif
+        snapshot->header = header;
+        if ((size_t)header.followingOffset + header.followingLength > size ||
+            (size_t)header.followersOffset + header.followersLength > size ||
+            !snapshot->following.attach(bytes + header.followingOffset, header.followingLength, header.nodeCount) ||
+            !snapshot->followers.attach(bytes + header.followersOffset, header.followersLength, header.nodeCount)) {
+            delete snapshot;
+            return nullptr;
+        }
+        return snapshot;
     }
 
-    ~SocialGraph() {
-        saveToDisk();
+    // Snapshot list of u with the delta applied, ascending
+    static void mergedList(const CSRSection& section, const DeltaMap& delta, int u, vector<int>& out) {
+        out.clear();
+        section.forEach(u, [&](int32_t v) {
+            out.push_back(v);
+            return true;
+        });
+        auto it = delta.find(u);
+        if (it == delta.end()) return;
+
+        vector<int> kept;
+        set_difference(out.begin(), out.end(), it->second.removed.begin(), it->second.removed.end(),
+                       back_inserter(kept));
+        out.clear();
+        merge(kept.begin(), kept.end(), it->second.added.begin(), it->second.added.end(), back_inserter(out));
     }
 
-    // Follow a user (directed edge: follower -> target)
-    bool followUser(int followerId, int targetId) {
-        if (followerId == targetId) return false; // Can't follow yourself
-        
-        // Check if already following
-        auto& following = adjacencyList[followerId];
-        for (int id : following) {
-            if (id == targetId) return false; // Already following
-        }
-        
-        following.push_back(targetId);
-        saveToDisk();
+    static int deltaCount(const DeltaMap& delta, int u) {
+        auto it = delta.find(u);
+        return it == delta.end() ? 0 : (int)it->second.added.size() - (int)it->second.removed.size();
+    }
+
+    static bool eraseSorted(vector<int>& ids, int id) {
+        auto it = lower_bound(ids.begin(), ids.end(), id);
+        if (it == ids.end() || *it != id) return false;
+        ids.erase(it);
         return true;
     }
 
-    // Unfollow a user
-    bool unfollowUser(int followerId, int targetId) {
-        auto it = adjacencyList.find(followerId);
-        if (it == adjacencyList.end()) return false;
-        
-        auto& following = it->second;
-        for (size_t i = 0; i < following.size(); i++) {
-            if (following[i] == targetId) {
-                following.erase(following.begin() + i);
-                saveToDisk();
-                return true;
+    static void insertSorted(vector<int>& ids, int id) {
+        ids.insert(lower_bound(ids.begin(), ids.end(), id), id);
+    }
+
+    // Records edge u -> v, or its removal, in one direction's delta
+    static void addEdge(DeltaMap& delta, int u, int v) {
+        DeltaList& list = delta[u];
+        if (!eraseSorted(list.removed, v)) insertSorted(list.added, v);
+        if (list.added.empty() && list.removed.empty()) delta.erase(u);
+    }
+
+    static void removeEdge(DeltaMap& delta, int u, int v) {
+        DeltaList& list = delta[u];
+        if (!eraseSorted(list.added, v)) insertSorted(list.removed, v);
+        if (list.added.empty() && list.removed.empty()) delta.erase(u);
+    }
+
+    // Rewrites delta, relative to the old snapshot, against the new one.
+    // Only users in the delta now or in the copy the compactor got can differ.
+    static void rebase(DeltaMap& delta, const DeltaMap& frozen, const CSRSection& oldSection,
+                       const CSRSection& newSection) {
+        vector<int> users;
+        for (const auto& pair : delta) users.push_back(pair.first);
+        for (const auto& pair : frozen) users.push_back(pair.first);
+        sort(users.begin(), users.end());
+        users.erase(unique(users.begin(), users.end()), users.end());
+
+        DeltaMap none;
+        vector<int> current, snapshot;
+        for (int u : users) {
+            mergedList(oldSection, delta, u, current);
+            mergedList(newSection, none, u, snapshot);
+            DeltaList list;
+            set_difference(current.begin(), current.end(), snapshot.begin(), snapshot.end(), back_inserter(list.added));
+            set_difference(snapshot.begin(), snapshot.end(), current.begin(), current.end(), back_inserter(list.removed));
+            if (list.added.empty() && list.removed.empty()) {
+                delta.erase(u);
+            } else {
+                delta[u] = list;
             }
         }
-        return false;
     }
 
-    // Get list of users that this user follows
-    vector<int> getFollowing(int userId) {
-        auto it = adjacencyList.find(userId);
-        if (it != adjacencyList.end()) {
-            return it->second;
+    static uint32_t nodeCountFor(const Snapshot* snapshot, const DeltaMap& following, const DeltaMap& followers) {
+        uint32_t nodes = snapshot ? snapshot->header.nodeCount : 0;
+        for (const auto& pair : following) nodes = max(nodes, (uint32_t)pair.first + 1);
+        for (const auto& pair : followers) nodes = max(nodes, (uint32_t)pair.first + 1);
+        return nodes;
+    }
+
+    // Merges a snapshot and a delta into a new snapshot, written beside the
+    // file and renamed over it. Safe to run beside readers of `snapshot`.
+    bool writeSnapshot(const Snapshot* snapshot, const DeltaMap& following, const DeltaMap& followers,
+                       int connections) {
+        const CSRSection& oldFollowing = snapshot ? snapshot->following : emptySection;
+        const CSRSection& oldFollowers = snapshot ? snapshot->followers : emptySection;
+        uint32_t nodes = nodeCountFor(snapshot, following, followers);
+
+        CSRWriter followingWriter, followersWriter;
+        vector<int> list;
+        for (uint32_t u = 0; u < nodes; u++) {
+            mergedList(oldFollowing, following, u, list);
+            followingWriter.addNode(list);
+            mergedList(oldFollowers, followers, u, list);
+            followersWriter.addNode(list);
         }
-        return vector<int>();
+
+        GraphHeader header;
+        header.magic = SOCIAL_GRAPH_MAGIC;
+        header.version = SOCIAL_GRAPH_VERSION;
+        header.nodeCount = nodes;
+        header.totalConnections = connections;
+        header.followingOffset = sizeof(GraphHeader);
+        header.followingLength = followingWriter.byteSize();
+        header.followersOffset = header.followingOffset + header.followingLength;
+        header.followersLength = followersWriter.byteSize();
+
+        string tempPath = filename + ".tmp";
+        ofstream file(tempPath, ios::binary | ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(reinterpret_cast<char*>(&header), sizeof(GraphHeader));
+        followingWriter.write(file);
+        followersWriter.write(file);
+        file.close();
+        if (file.fail() || !WriteAheadLog::syncPath(tempPath)) return false;
+        return rename(tempPath.c_str(), filename.c_str()) == 0;
     }
 
-    // Get list of users that follow this user
-    vector<int> getFollowers(int userId) {
-        vector<int> followers;
-        for (const auto& pair : adjacencyList) {
-            for (int followedId : pair.second) {
-                if (followedId == userId) {
-                    followers.push_back(pair.first);
-                    break;
-                }
+    static bool readList(ifstream& file, vector<int>& ids) {
+        int count;
+        if (!file.read(reinterpret_cast<char*>(&count), sizeof(int)) || count < 0) return false;
+        ids.resize(count);
+        return count == 0 || file.read(reinterpret_cast<char*>(ids.data()), sizeof(int) * count);
+    }
+
+    // Reads a version 1 or 2 file into the delta; true if there was one.
+    // In-edges are rebuilt from the out-edges either way.
+    bool loadLegacy() {
+        ifstream file(filename, ios::binary);
+        if (!file.is_open()) return false; // File doesn't exist yet
+
+        int header[2];
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+        bool versioned = (uint32_t)header[0] == SOCIAL_GRAPH_MAGIC;
+        if (versioned && (header[1] != 2 || !file.read(reinterpret_cast<char*>(header), sizeof(header)))) {
+            return false;
+        }
+        int totalUsers = header[0];
+
+        vector<int> following, followers;
+        for (int i = 0; i < totalUsers; i++) {
+            int userId;
+            if (!file.read(reinterpret_cast<char*>(&userId), sizeof(int))) break;
+            if (!readList(file, following)) break;
+            if (versioned && !readList(file, followers)) break;
+            for (int followedId : following) {
+                applyFollow(userId, followedId);
             }
         }
-        return followers;
+        return true;
     }
 
-    // Check if follower follows target
-    bool isFollowing(int followerId, int targetId) {
-        auto it = adjacencyList.find(followerId);
-        if (it == adjacencyList.end()) return false;
-        
-        for (int id : it->second) {
-            if (id == targetId) return true;
+    bool applyFollow(int followerId, int targetId) {
+        if (followerId == targetId) return false; // Can't follow yourself
+        if (followerId < 0 || targetId < 0) return false;
+        if (isFollowing(followerId, targetId)) return false; // Already following
+
+        addEdge(followingDelta, followerId, targetId);
+        addEdge(followersDelta, targetId, followerId);
+        totalConnections++;
+        userBound = max(userBound, max(followerId, targetId) + 1);
+        return true;
+    }
+
+    bool applyUnfollow(int followerId, int targetId) {
+        if (!isFollowing(followerId, targetId)) return false;
+
+        removeEdge(followingDelta, followerId, targetId);
+        removeEdge(followersDelta, targetId, followerId);
+        totalConnections--;
+        return true;
+    }
+
+    // Writes the record through to the page cache; waitJournal() makes it durable
+    void appendJournal(int op, int followerId, int targetId) {
+        JournalRecord record = {op, followerId, targetId};
+        journal.write(reinterpret_cast<const char*>(&record), sizeof(JournalRecord));
+        journal.flush();
+        {
+            lock_guard<mutex> lock(syncMutex);
+            journalAppended++;
+            if (journal.fail()) journalFailed = true;
+        }
+        if (++journalRecords >= SOCIAL_JOURNAL_LIMIT) {
+            requestCompaction();
         }
-        return false;
     }
 
-    // Get counts
-    int getFollowingCount(int userId) {
-        auto it = adjacencyList.find(userId);
-        return (it != adjacencyList.end()) ? it->second.size() : 0;
+    // Returns the number of records applied; a torn last record is ignored
+    int replayJournal(const string& path) {
+        ifstream file(path, ios::binary);
+        if (!file.is_open()) return 0;
+
+        int applied = 0;
+        JournalRecord record;
+        while (file.read(reinterpret_cast<char*>(&record), sizeof(JournalRecord))) {
+            if (record.op == JOURNAL_FOLLOW) {
+                applyFollow(record.followerId, record.targetId);
+            } else if (record.op == JOURNAL_UNFOLLOW) {
+                applyUnfollow(record.followerId, record.targetId);
+            } else {
+                break;
+            }
+            applied++;
+        }
+        return applied;
     }
 
-    int getFollowersCount(int userId) {
-        return getFollowers(userId).size();
+    // Rotates the journal and queues a compaction. Skipped while the last one
+    // is running or not yet installed, or failed and left its journal behind;
+    // the journal just keeps growing until then.
+    void requestCompaction() {
+        lock_guard<mutex> lock(compactMutex);
+        if (compacting || compacted || ifstream(rotatedJournalPath()).good()) return;
+
+        // Synced first: once renamed, waitJournal() only syncs the new file
+        journal.close();
+        if (!WriteAheadLog::syncPath(journalPath())) {
+            lock_guard<mutex> syncLock(syncMutex);
+            journalFailed = true;
+        }
+        rename(journalPath().c_str(), rotatedJournalPath().c_str());
+        journal.open(journalPath(), ios::binary | ios::app);
+        journalRecords = 0;
+
+        frozenFollowing = new DeltaMap(followingDelta);
+        frozenFollowers = new DeltaMap(followersDelta);
+        frozenConnections = totalConnections;
+        jobPending = true;
+        compacting = true;
+        compactReady.notify_one();
     }
 
-    // Persistence
-    void saveToDisk() {
-        ofstream file(filename, ios::binary);
-        if (!file.is_open()) return;
+    void compactLoop() {
+        unique_lock<mutex> lock(compactMutex);
+        while (true) {
+            compactReady.wait(lock, [this] { return jobPending || stopping; });
+            if (!jobPending) return;
 
-        // Count total connections
-        int totalConnections = 0;
-        for (const auto& pair : adjacencyList) {
-            totalConnections += pair.second.size();
+            jobPending = false;
+            lock.unlock();
+            bool written = writeSnapshot(base, *frozenFollowing, *frozenFollowers, frozenConnections);
+            if (written) {
+                remove(rotatedJournalPath().c_str());
+            }
+            lock.lock();
+            compacting = false;
+            compacted = written;
+            if (!written) {
+                dropFrozen();
+            }
         }
+    }
 
-        // Write header
-        GraphHeader header;
-        header.totalUsers = adjacencyList.size();
-        header.totalConnections = totalConnections;
-        file.write(reinterpret_cast<char*>(&header), sizeof(GraphHeader));
+    void dropFrozen() {
+        delete frozenFollowing;
+        delete frozenFollowers;
+        frozenFollowing = nullptr;
+        frozenFollowers = nullptr;
+    }
 
-        // Write each user's following list
-        for (const auto& pair : adjacencyList) {
-            int userId = pair.first;
-            int followingCount = pair.second.size();
-            
-            file.write(reinterpret_cast<const char*>(&userId), sizeof(int));
-            file.write(reinterpret_cast<const char*>(&followingCount), sizeof(int));
-            
-            for (int followedId : pair.second) {
-                file.write(reinterpret_cast<const char*>(&followedId), sizeof(int));
+    // Switches to a snapshot the compactor finished. Runs at the start of a
+    // mutation, which the caller serialises against every reader.
+    void installCompacted() {
+        {
+            lock_guard<mutex> lock(compactMutex);
+            if (!compacted) return;
+            compacted = false;
+        }
+        Snapshot* next = openSnapshot(filename);
+        if (next) {
+            rebase(followingDelta, *frozenFollowing, baseFollowing(), next->following);
+            rebase(followersDelta, *frozenFollowers, baseFollowers(), next->followers);
+            delete base;
+            base = next;
+        }
+        dropFrozen();
+    }
+
+    // Writes a full snapshot in the calling thread and starts an empty
+    // journal; only while the compactor is idle
+    void saveToDisk() {
+        journal.close();
+        if (writeSnapshot(base, followingDelta, followersDelta, totalConnections)) {
+            Snapshot* next = openSnapshot(filename);
+            if (next) {
+                delete base;
+                base = next;
+                followingDelta.clear();
+                followersDelta.clear();
             }
+            remove(rotatedJournalPath().c_str());
+            journal.open(journalPath(), ios::binary | ios::trunc);
+            journalRecords = 0;
+        } else {
+            journal.open(journalPath(), ios::binary | ios::app);
         }
+    }
 
-        file.close();
+public:
+    SocialGraph(const string& file)
+        : base(nullptr), filename(file), totalConnections(0), userBound(0), journalRecords(0),
+          journalAppended(0), journalDurable(0), journalSyncing(false), journalFailed(false), frozenFollowing(nullptr), frozenFollowers(nullptr), frozenConnections(0), jobPending(false),
+          compacting(false), compacted(false), stopping(false) {
+        base = openSnapshot(filename);
+        bool rewrite = false;
+        if (base) {
+            totalConnections = base->header.totalConnections;
+            userBound = base->header.nodeCount;
+        } else {
+            rewrite = loadLegacy();
+        }
+        int replayed = replayJournal(rotatedJournalPath()) + replayJournal(journalPath());
+        if (rewrite || replayed > 0) {
+            saveToDisk();
+        } else {
+            journal.open(journalPath(), ios::binary | ios::app);
+        }
+        compactor = thread(&SocialGraph::compactLoop, this);
     }
 
-    void loadFromDisk() {
-        ifstream file(filename, ios::binary);
-        if (!file.is_open()) return; // File doesn't exist yet
+    ~SocialGraph() {
+        {
+            lock_guard<mutex> lock(compactMutex);
+            stopping = true;
+        }
+        compactReady.notify_one();
+        compactor.join();
+        if (!followingDelta.empty() || !followersDelta.empty() || compacted || journalRecords > 0) {
+            saveToDisk();
+        }
+        dropFrozen();
+        delete base;
+    }
 
-        GraphHeader header;
-        file.read(reinterpret_cast<char*>(&header), sizeof(GraphHeader));
+    // Follow a user (directed edge: follower -> target)
+    bool followUser(int followerId, int targetId) {
+        installCompacted();
+        if (!applyFollow(followerId, targetId)) return false;
+        appendJournal(JOURNAL_FOLLOW, followerId, targetId);
+        return true;
+    }
 
-        adjacencyList.clear();
+    // Unfollow a user
+    bool unfollowUser(int followerId, int targetId) {
+        installCompacted();
+        if (!applyUnfollow(followerId, targetId)) return false;
+        appendJournal(JOURNAL_UNFOLLOW, followerId, targetId);
+        return true;
+    }
 
-        for (int i = 0; i < header.totalUsers; i++) {
-            int userId, followingCount;
-            file.read(reinterpret_cast<char*>(&userId), sizeof(int));
-            file.read(reinterpret_cast<char*>(&followingCount), sizeof(int));
+    // Journal records appended so far; pass to waitJournal()
+    uint64_t journalSequence() {
+        lock_guard<mutex> lock(syncMutex);
+        return journalAppended;
+    }
 
-            vector<int> following;
-            for (int j = 0; j < followingCount; j++) {
-                int followedId;
-                file.read(reinterpret_cast<char*>(&followedId), sizeof(int));
-                following.push_back(followedId);
+    // Blocks until the first `sequence` journal records are on disk; false
+    // if the journal failed first. Call without the database lock so that
+    // concurrent follows share one fsync.
+    bool waitJournal(uint64_t sequence) {
+        unique_lock<mutex> lock(syncMutex);
+        while (journalDurable < sequence) {
+            if (journalFailed) return false;
+            if (journalSyncing) {
+                journalSynced.wait(lock);
+                continue;
             }
 
-            adjacencyList[userId] = following;
+            journalSyncing = true;
+            uint64_t target = journalAppended;
+            lock.unlock();
+            bool synced = WriteAheadLog::syncPath(journalPath());
+            lock.lock();
+            if (synced) {
+                journalDurable = target;
+            } else {
+                journalFailed = true;
+            }
+            journalSyncing = false;
+            journalSynced.notify_all();
         }
+        return true;
+    }
 
-        file.close();
+    // Get list of users that this user follows, by user id
+    vector<int> getFollowing(int userId) {
+        vector<int> following;
+        mergedList(baseFollowing(), followingDelta, userId, following);
+        return following;
+    }
+
+    // Get list of users that follow this user, by user id
+    vector<int> getFollowers(int userId) {
+        vector<int> followers;
+        mergedList(baseFollowers(), followersDelta, userId, followers);
+        return followers;
+    }
+
+    // Users this user follows without building a list: the snapshot's
+    // (ascending) then the delta's. Stops when visit returns false.
+    template<typename Visitor>
+    void forEachFollowing(int userId, Visitor visit) {
+        auto it = followingDelta.find(userId);
+        const DeltaList* delta = it != followingDelta.end() ? &it->second : nullptr;
+        bool more = true;
+        baseFollowing().forEach(userId, [&](int32_t v) {
+            if (delta && binary_search(delta->removed.begin(), delta->removed.end(), v)) return true;
+            more = visit(v);
+            return more;
+        });
+        if (!more || !delta) return;
+        for (int v : delta->added) {
+            if (!visit(v)) return;
+        }
+    }
+
+    // Check if follower follows target
+    bool isFollowing(int followerId, int targetId) {
+        auto it = followingDelta.find(followerId);
+        if (it != followingDelta.end()) {
+            const DeltaList& list = it->second;
+            if (binary_search(list.added.begin(), list.added.end(), targetId)) return true;
+            if (binary_search(list.removed.begin(), list.removed.end(), targetId)) return false;
+        }
+        return baseFollowing().contains(followerId, targetId);
+    }
+
+    // Get counts
+    int getFollowingCount(int userId) {
+        return baseFollowing().degree(userId) + deltaCount(followingDelta, userId);
+    }
+
+    int getFollowersCount(int userId) {
+        return baseFollowers().degree(userId) + deltaCount(followersDelta, userId);
+    }
+
+    int getUserBound() const {
+        return userBound;
     }
 };
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+using namespace std;
+
+// A searchable string and who it belongs to. kind tells callers what id
+// refers to; the suffix array does not look at it.
+struct SuffixEntry {
+    int id;
+    int kind;
+    float score;
+    string text;
+};
+
+// Immutable suffix array over the lower-cased texts of its entries, joined
+// with '\1' separators. find() binary-searches the sorted suffixes for the
+// query (O(m log n) character compares) and maps each occurrence back to
+// its entry through the sorted entry start offsets.
+class SuffixArray {
+private:
+    struct Owner {
+        int id;
+        int kind;
+        float score;
+    };
+
+    string text;
+    vector<int> suffixes;    // text positions, in suffix order
+    vector<uint32_t> starts; // where each entry's text begins
+    vector<Owner> owners;
+
+    // Lower-cased, with the separator and sentinel bytes blanked out
+    static string normalize(const string& str) {
+        string result = str;
+        for (char& c : result) {
+            c = (c == '\0' || c == '\1') ? ' ' : (char)tolower((unsigned char)c);
+        }
+        return result;
+    }
+
+    // Prefix doubling with counting sorts over cyclic shifts, O(n log n).
+    // text ends in a unique '\0', so cyclic order equals suffix order.
+    void sortSuffixes() {
+        int n = text.size();
+        vector<int> order(n), classes(n), nextOrder(n), nextClasses(n);
+        vector<int> counts(max(256, n), 0);
+        for (int i = 0; i < n; i++) counts[(unsigned char)text[i]]++;
+        for (int i = 1; i < 256; i++) counts[i] += counts[i - 1];
+        for (int i = n - 1; i >= 0; i--) order[--counts[(unsigned char)text[i]]] = i;
+        int classCount = 1;
+        classes[order[0]] = 0;
+        for (int i = 1; i < n; i++) {
+            if (text[order[i]] != text[order[i - 1]]) classCount++;
+            classes[order[i]] = classCount - 1;
+        }
+
+        for (int half = 1; half < n && classCount < n; half <<= 1) {
+            // Sorted by the second half already: shift each start back
+            for (int i = 0; i < n; i++) {
+                nextOrder[i] = order[i] - half < 0 ? order[i] - half + n : order[i] - half;
+            }
+            fill(counts.begin(), counts.begin() + classCount, 0);
+            for (int i = 0; i < n; i++) counts[classes[nextOrder[i]]]++;
+            for (int i = 1; i < classCount; i++) counts[i] += counts[i - 1];
+            for (int i = n - 1; i >= 0; i--) order[--counts[classes[nextOrder[i]]]] = nextOrder[i];
+
+            classCount = 1;
+            nextClasses[order[0]] = 0;
+            for (int i = 1; i < n; i++) {
+                int a = order[i], b = order[i - 1];
+                int aHalf = a + half < n ? a + half : a + half - n;
+                int bHalf = b + half < n ? b + half : b + half - n;
+                if (classes[a] != classes[b] || classes[aHalf] != classes[bHalf]) classCount++;
+                nextClasses[a] = classCount - 1;
+            }
+            classes.swap(nextClasses);
+        }
+
+        // Drop the sentinel's suffix (always first) and those starting on a
+        // separator, which no query can match
+        suffixes.clear();
+        for (int i = 1; i < n; i++) {
+            if (text[order[i]] != '\1') suffixes.push_back(order[i]);
+        }
+    }
+
+public:
+    SuffixArray(const vector<SuffixEntry>& entries) {
+        for (const auto& entry : entries) {
+            starts.push_back(text.size());
+            owners.push_back({entry.id, entry.kind, entry.score});
+            text += normalize(entry.text);
+            text += '\1';
+        }
+        text += '\0';
+        sortSuffixes();
+    }
+
+    // Entries containing query, best score first (then kind and id). At
+    // most scanLimit occurrences are looked at, so a very common query
+    // ranks only the entries those occurrences belong to.
+    vector<SuffixEntry> find(const string& query, size_t scanLimit) const {
+        vector<SuffixEntry> results;
+        string needle = normalize(query);
+        if (needle.empty()) return results;
+
+        size_t m = needle.size();
+        auto first = lower_bound(suffixes.begin(), suffixes.end(), needle,
+                                 [&](int pos, const string& q) { return text.compare(pos, m, q) < 0; });
+        auto last = upper_bound(first, suffixes.end(), needle,
+                                [&](const string& q, int pos) { return text.compare(pos, m, q) > 0; });
+        if (first == last) return results;
+
+        vector<uint32_t> matched;
+        for (auto it = first; it != last && matched.size() < scanLimit; it++) {
+            matched.push_back(upper_bound(starts.begin(), starts.end(), (uint32_t)*it) - starts.begin() - 1);
+        }
+        sort(matched.begin(), matched.end());
+        matched.erase(unique(matched.begin(), matched.end()), matched.end());
+
+        for (uint32_t index : matched) {
+            const Owner& owner = owners[index];
+            results.push_back({owner.id, owner.kind, owner.score, string()});
+        }
+        sort(results.begin(), results.end(), [](const SuffixEntry& a, const SuffixEntry& b) {
+            if (a.score != b.score) return a.score > b.score;
+            if (a.kind != b.kind) return a.kind < b.kind;
+            return a.id < b.id;
+        });
+        return results;
+    }
+
+    size_t size() const {
+        return owners.size();
+    }
+};
@@ -2,96 +2,447 @@
 
 #include <string>
 #include <vector>
-#include <map>
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <chrono>
+#include <unordered_map>
 
 using namespace std;
 
+// 16 bytes. A node with one child keeps it inline (child + childLabel); with
+// more, child is the offset of its run in the edge pools. Likewise a single
+// id sits in ids, several are a run in the id pool. Runs hold a power of two
+// slots and move to the end of their pool when they fill up.
 struct TrieNode {
-    map<char, TrieNode*> children;
-    vector<int> filmIds;  // Store film IDs at this node
-    bool isEndOfWord;
-    
-    TrieNode() : isEndOfWord(false) {}
-    
-    ~TrieNode() {
-        for (auto& pair : children) {
-            delete pair.second;
-        }
-    }
+    uint32_t child;
+    uint32_t ids;
+    uint32_t idCount;
+    uint16_t childCount;
+    char childLabel;
 };
 
+// Prefix tree over lower-cased keys with spaces skipped. All nodes live in
+// one array and refer to each other by index; child lists are sorted by
+// label, so a lookup is a scan (or binary search) of a few contiguous bytes
+// per character and nothing is freed node by node.
+//
+// A ranked trie (topK > 0) also scores each id and keeps, for every node
+// with more than topK ids below it, its best topK ids in a block of the top
+// pool. search(prefix, k) then reads one block however broad the prefix;
+// smaller subtrees are walked, which visits at most topK ids.
+//
+// One id may be inserted under several keys, some on the same path (a
+// title indexed from every word start). Blocks and results hold each id
+// once; subtreeIds counts (key, id) pairs, so a block can have fewer than
+// topK distinct ids, with the unused slots set to -1.
 class Trie {
 private:
-    TrieNode* root;
-    
+    vector<TrieNode> nodes;
+    vector<char> edgeLabels;     // child runs: labels, ascending
+    vector<uint32_t> edgeNodes;  // and the matching node indexes
+    vector<int> idPool;
+
+    // Ranked tries only, indexed like nodes
+    uint32_t topK;
+    vector<uint32_t> subtreeIds;
+    vector<uint32_t> topBlock;   // 1 + block index in topPool, or 0
+    vector<int> topPool;
+    vector<uint32_t> freeBlocks;
+    vector<float> scores;        // by id
+
     string toLowerCase(const string& str) {
         string result = str;
         transform(result.begin(), result.end(), result.begin(), ::tolower);
         return result;
     }
-    
-    void collectResults(TrieNode* node, vector<int>& results) {
-        if (node->isEndOfWord) {
-            for (int id : node->filmIds) {
-                results.push_back(id);
+
+    static bool isPowerOfTwo(uint32_t n) {
+        return (n & (n - 1)) == 0;
+    }
+
+    uint32_t newNode() {
+        nodes.push_back(TrieNode{0, 0, 0, 0, 0});
+        if (topK > 0) {
+            subtreeIds.push_back(0);
+            topBlock.push_back(0);
+        }
+        return nodes.size() - 1;
+    }
+
+    // Index of node's child labelled c, or 0 (the root is never a child)
+    uint32_t findChild(uint32_t node, char c) const {
+        const TrieNode& n = nodes[node];
+        if (n.childCount == 0) return 0;
+        if (n.childCount == 1) return n.childLabel == c ? n.child : 0;
+        const char* first = edgeLabels.data() + n.child;
+        const char* last = first + n.childCount;
+        const char* it;
+        if (n.childCount <= 16) {
+            it = first;
+            while (it != last && *it < c) it++;
+        } else {
+            it = lower_bound(first, last, c);
+        }
+        return it != last && *it == c ? edgeNodes[n.child + (it - first)] : 0;
+    }
+
+    uint32_t addChild(uint32_t node, char c) {
+        uint32_t created = newNode();
+        TrieNode& n = nodes[node];
+        if (n.childCount == 0) {
+            n.child = created;
+            n.childLabel = c;
+            n.childCount = 1;
+            return created;
+        }
+
+        if (n.childCount == 1 || isPowerOfTwo(n.childCount)) {
+            uint32_t moved = edgeLabels.size();
+            uint32_t capacity = n.childCount * 2;
+            edgeLabels.resize(moved + capacity);
+            edgeNodes.resize(moved + capacity);
+            if (n.childCount == 1) {
+                edgeLabels[moved] = n.childLabel;
+                edgeNodes[moved] = n.child;
+            } else {
+                copy(edgeLabels.begin() + n.child, edgeLabels.begin() + n.child + n.childCount,
+                     edgeLabels.begin() + moved);
+                copy(edgeNodes.begin() + n.child, edgeNodes.begin() + n.child + n.childCount,
+                     edgeNodes.begin() + moved);
             }
+            n.child = moved;
         }
-        
-        for (auto& pair : node->children) {
-            collectResults(pair.second, results);
+
+        char* labels = edgeLabels.data() + n.child;
+        uint32_t* targets = edgeNodes.data() + n.child;
+        uint32_t pos = n.childCount;
+        while (pos > 0 && labels[pos - 1] > c) {
+            labels[pos] = labels[pos - 1];
+            targets[pos] = targets[pos - 1];
+            pos--;
         }
+        labels[pos] = c;
+        targets[pos] = created;
+        n.childCount++;
+        return created;
     }
 
-public:
-    Trie() {
-        root = new TrieNode();
+    void addId(uint32_t node, int id) {
+        TrieNode& n = nodes[node];
+        if (n.idCount == 0) {
+            n.ids = id;
+        } else {
+            if (n.idCount == 1 || isPowerOfTwo(n.idCount)) {
+                uint32_t moved = idPool.size();
+                idPool.resize(moved + n.idCount * 2);
+                if (n.idCount == 1) {
+                    idPool[moved] = n.ids;
+                } else {
+                    copy(idPool.begin() + n.ids, idPool.begin() + n.ids + n.idCount, idPool.begin() + moved);
+                }
+                n.ids = moved;
+            }
+            idPool[n.ids + n.idCount] = id;
+        }
+        n.idCount++;
+    }
+
+    bool removeId(uint32_t node, int id) {
+        TrieNode& n = nodes[node];
+        if (n.idCount == 1) {
+            if ((int)n.ids != id) return false;
+        } else {
+            int* first = idPool.data() + n.ids;
+            int* last = first + n.idCount;
+            int* it = find(first, last, id);
+            if (it == last) return false;
+            copy(it + 1, last, it);
+            if (n.idCount == 2) n.ids = first[0];
+        }
+        n.idCount--;
+        return true;
+    }
+
+    // Higher score first, then lower id
+    bool ranksBefore(int a, int b) const {
+        float sa = scores[a], sb = scores[b];
+        return sa != sb ? sa > sb : a < b;
+    }
+
+    // Best k distinct ids, in rank order
+    void keepBest(vector<int>& ids, size_t k) const {
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        k = min(k, ids.size());
+        partial_sort(ids.begin(), ids.begin() + k, ids.end(),
+                     [this](int a, int b) { return ranksBefore(a, b); });
+        ids.resize(k);
+    }
+
+    // Fills node's block from its whole subtree
+    void buildTop(uint32_t node) {
+        vector<int> ids;
+        collectResults(node, ids);
+        keepBest(ids, topK);
+        if (!topBlock[node]) {
+            if (freeBlocks.empty()) {
+                topPool.resize(topPool.size() + topK);
+                topBlock[node] = topPool.size() / topK;
+            } else {
+                topBlock[node] = freeBlocks.back();
+                freeBlocks.pop_back();
+            }
+        }
+        int* block = topPool.data() + (topBlock[node] - 1) * topK;
+        copy(ids.begin(), ids.end(), block);
+        fill(block + ids.size(), block + topK, -1);
+    }
+
+    // The used slots of node's block
+    vector<int> blockIds(uint32_t node, size_t k) const {
+        const int* block = topPool.data() + (topBlock[node] - 1) * topK;
+        const int* last = block;
+        while (last != block + min(k, (size_t)topK) && *last >= 0) last++;
+        return vector<int>(block, last);
+    }
+
+    void dropTop(uint32_t node) {
+        freeBlocks.push_back(topBlock[node]);
+        topBlock[node] = 0;
+    }
+
+    // Puts an id into node's block if it is not there yet and ranks high enough
+    void offerTop(uint32_t node, int id) {
+        int* block = topPool.data() + (topBlock[node] - 1) * topK;
+        if (find(block, block + topK, id) != block + topK) return;
+        if (block[topK - 1] >= 0 && !ranksBefore(id, block[topK - 1])) return;
+        uint32_t pos = topK - 1;
+        while (pos > 0 && (block[pos - 1] < 0 || ranksBefore(id, block[pos - 1]))) {
+            block[pos] = block[pos - 1];
+            pos--;
+        }
+        block[pos] = id;
+    }
+
+    // Nodes from the root to key's node; empty if key is not in the trie
+    vector<uint32_t> pathTo(const string& key) {
+        string lowerKey = toLowerCase(key);
+        vector<uint32_t> path(1, 0);
+        for (char c : lowerKey) {
+            if (c == ' ') continue;
+            uint32_t next = findChild(path.back(), c);
+            if (!next) return vector<uint32_t>();
+            path.push_back(next);
+        }
+        return path;
+    }
+
+    struct FuzzyWalk {
+        string query;
+        int maxEdits;
+        vector<int> rows;            // one DP row of query.size() + 1 per depth
+        unordered_map<int, int> edits;  // best distance seen per id
+        chrono::steady_clock::time_point deadline;
+        int visited;
+        bool expired;
+    };
+
+    // Records every id the node offers (its top block, or its small
+    // subtree) at the given distance, keeping each id's best
+    void harvest(uint32_t node, int distance, FuzzyWalk& walk) {
+        vector<int> ids;
+        if (topBlock[node]) {
+            ids = blockIds(node, topK);
+        } else {
+            collectResults(node, ids);
+        }
+        for (int id : ids) {
+            auto it = walk.edits.find(id);
+            if (it == walk.edits.end() || it->second > distance) walk.edits[id] = distance;
+        }
+    }
+
+    // Row for depth + 1 from the row at depth, reading label c
+    void fuzzyVisit(uint32_t node, char c, size_t depth, FuzzyWalk& walk) {
+        if (walk.expired) return;
+        if (++walk.visited % 256 == 0 && chrono::steady_clock::now() > walk.deadline) {
+            walk.expired = true;
+            return;
+        }
+
+        size_t width = walk.query.size() + 1;
+        if (walk.rows.size() < (depth + 2) * width) walk.rows.resize((depth + 2) * width);
+        const int* prev = walk.rows.data() + depth * width;
+        int* row = walk.rows.data() + (depth + 1) * width;
+        row[0] = prev[0] + 1;
+        int best = row[0];
+        for (size_t j = 1; j < width; j++) {
+            int substitute = prev[j - 1] + (walk.query[j - 1] == c ? 0 : 1);
+            row[j] = min(min(prev[j], row[j - 1]) + 1, substitute);
+            best = min(best, row[j]);
+        }
+
+        if (row[width - 1] <= walk.maxEdits) harvest(node, row[width - 1], walk);
+        if (best > walk.maxEdits) return;
+
+        const TrieNode& n = nodes[node];
+        if (n.childCount == 1) {
+            fuzzyVisit(n.child, n.childLabel, depth + 1, walk);
+        } else {
+            for (uint32_t i = 0; i < n.childCount; i++) {
+                fuzzyVisit(edgeNodes[n.child + i], edgeLabels[n.child + i], depth + 1, walk);
+            }
+        }
+    }
+
+    // A node's own ids, then its children's in label order
+    void collectResults(uint32_t node, vector<int>& results) const {
+        const TrieNode& n = nodes[node];
+        if (n.idCount == 1) {
+            results.push_back((int)n.ids);
+        } else if (n.idCount > 1) {
+            results.insert(results.end(), idPool.begin() + n.ids, idPool.begin() + n.ids + n.idCount);
+        }
+
+        if (n.childCount == 1) {
+            collectResults(n.child, results);
+        } else {
+            for (uint32_t i = 0; i < n.childCount; i++) {
+                collectResults(edgeNodes[n.child + i], results);
+            }
+        }
     }
-    
-    ~Trie() {
-        delete root;
+
+public:
+    Trie(int rankedTop = 0) : topK(rankedTop) {
+        newNode();
     }
-    
-    void insert(const string& title, int filmId) {
+
+    // score only matters to a ranked trie
+    void insert(const string& title, int filmId, float score = 0) {
         string lowerTitle = toLowerCase(title);
-        TrieNode* current = root;
-        
+        uint32_t current = 0;
+        vector<uint32_t> path(1, 0);
+
         for (char c : lowerTitle) {
             if (c == ' ') continue;  // Skip spaces for better search
-            
-            if (current->children.find(c) == current->children.end()) {
-                current->children[c] = new TrieNode();
+
+            uint32_t next = findChild(current, c);
+            current = next ? next : addChild(current, c);
+            path.push_back(current);
+        }
+
+        addId(current, filmId);
+        if (topK == 0) return;
+
+        if ((size_t)filmId >= scores.size()) scores.resize(filmId + 1);
+        scores[filmId] = score;
+        for (uint32_t node : path) {
+            subtreeIds[node]++;
+            if (topBlock[node]) {
+                offerTop(node, filmId);
+            } else if (subtreeIds[node] > topK) {
+                buildTop(node);
+            }
+        }
+    }
+
+    // Removes one (key, id) pair; false if it was not there
+    bool remove(const string& key, int id) {
+        vector<uint32_t> path = pathTo(key);
+        if (path.empty() || !removeId(path.back(), id)) return false;
+        if (topK == 0) return true;
+
+        for (uint32_t node : path) {
+            subtreeIds[node]--;
+            if (!topBlock[node]) continue;
+            if (subtreeIds[node] <= topK) {
+                dropTop(node);
+            } else {
+                const int* block = topPool.data() + (topBlock[node] - 1) * topK;
+                if (find(block, block + topK, id) != block + topK) buildTop(node);
             }
-            current = current->children[c];
         }
-        
-        current->isEndOfWord = true;
-        current->filmIds.push_back(filmId);
+        return true;
     }
-    
+
     vector<int> search(const string& prefix) {
         string lowerPrefix = toLowerCase(prefix);
-        TrieNode* current = root;
+        uint32_t current = 0;
         vector<int> results;
-        
+
         // Navigate to the prefix node
         for (char c : lowerPrefix) {
             if (c == ' ') continue;
-            
-            if (current->children.find(c) == current->children.end()) {
-                return results;  // Prefix not found
-            }
-            current = current->children[c];
+
+            current = findChild(current, c);
+            if (!current) return results;  // Prefix not found
         }
-        
-        // Collect all film IDs from this node down
+
+        // Collect all ids from this node down
         collectResults(current, results);
-        
+
+        return results;
+    }
+
+    // Best k ids under prefix, highest score first (key order if unranked)
+    vector<int> search(const string& prefix, size_t k) {
+        vector<uint32_t> path = pathTo(prefix);
+        if (path.empty()) return vector<int>();
+
+        uint32_t node = path.back();
+        vector<int> results;
+        if (topK == 0) {
+            collectResults(node, results);
+            if (results.size() > k) results.resize(k);
+            return results;
+        }
+        if (topBlock[node] && k <= topK) {
+            return blockIds(node, k);
+        }
+        collectResults(node, results);
+        keepBest(results, k);
+        return results;
+    }
+
+    // Ids of a ranked trie with a key prefix within maxEdits edits of query:
+    // fewest edits first, then highest score. The walk stops at budget, and
+    // whatever it found by then is returned. Pairs are (id, edits).
+    vector<pair<int, int>> fuzzySearch(const string& query, int maxEdits, size_t k,
+                                       chrono::microseconds budget) {
+        FuzzyWalk walk;
+        for (char c : toLowerCase(query)) {
+            if (c != ' ') walk.query += c;
+        }
+        walk.maxEdits = maxEdits;
+        walk.deadline = chrono::steady_clock::now() + budget;
+        walk.visited = 0;
+        walk.expired = false;
+        size_t width = walk.query.size() + 1;
+        walk.rows.resize(width * 2);
+        for (size_t j = 0; j < width; j++) walk.rows[j] = j;
+
+        if ((int)walk.query.size() <= maxEdits) harvest(0, walk.query.size(), walk);
+        const TrieNode& root = nodes[0];
+        if (root.childCount == 1) {
+            fuzzyVisit(root.child, root.childLabel, 0, walk);
+        } else {
+            for (uint32_t i = 0; i < root.childCount; i++) {
+                fuzzyVisit(edgeNodes[root.child + i], edgeLabels[root.child + i], 0, walk);
+            }
+        }
+
+        vector<pair<int, int>> results(walk.edits.begin(), walk.edits.end());
+        sort(results.begin(), results.end(), [this](const pair<int, int>& a, const pair<int, int>& b) {
+            if (a.second != b.second) return a.second < b.second;
+            return ranksBefore(a.first, b.first);
+        });
+        if (results.size() > k) results.resize(k);
         return results;
     }
-    
+
     bool isEmpty() const {
-        return root->children.empty();
+        return nodes[0].childCount == 0;
     }
 };
@@ -0,0 +1,438 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// On-disk offsets are fixed at 4 bytes so .bin files written by the MinGW
+// build (where long is 32-bit) open unchanged on 64-bit Linux.
+typedef int32_t FilePos;
+
+// Checkpoint once the log grows past this many bytes
+#define WAL_CHECKPOINT_SIZE (16 * 1024 * 1024)
+
+#define WAL_BATCH_MAGIC 0x4C415743u // "CWAL"
+#define WAL_MAX_BATCH_SIZE (256 * 1024 * 1024)
+
+// One commit record: the full images of the pages a mutation touched plus the
+// tree headers. Replay applies a record only if it arrived whole.
+class WALBatch {
+private:
+    string payload;
+
+    void addName(const string& file) {
+        uint16_t length = file.length();
+        payload.append((const char*)&length, sizeof(length));
+        payload.append(file);
+    }
+
+public:
+    enum EntryType : uint8_t {
+        ENTRY_PAGE = 1,
+        ENTRY_HEADER = 2
+    };
+
+    void addPage(const string& file, FilePos pos, const char* data, uint32_t size) {
+        payload.push_back((char)ENTRY_PAGE);
+        addName(file);
+        payload.append((const char*)&pos, sizeof(pos));
+        payload.append((const char*)&size, sizeof(size));
+        payload.append(data, size);
+    }
+
+    void addHeader(const string& file, FilePos rootPos, FilePos nextPos) {
+        payload.push_back((char)ENTRY_HEADER);
+        addName(file);
+        payload.append((const char*)&rootPos, sizeof(rootPos));
+        payload.append((const char*)&nextPos, sizeof(nextPos));
+    }
+
+    const string& getPayload() const {
+        return payload;
+    }
+};
+
+// Thrown where a mutation finds that its commit could not be made durable
+class WALError : public runtime_error {
+public:
+    WALError(const string& message) : runtime_error(message) {}
+};
+
+struct WALStats {
+    uint64_t commits;
+    uint64_t syncs;
+    uint64_t checkpoints;
+    uint64_t bytes;
+};
+
+// Redo log of page images shared by every tree. Mutations append a batch
+// while holding the database lock and wait for durability after releasing
+// it; whichever waiter finds no flush running becomes the leader, writes out
+// everything appended so far and fsyncs once for the whole group.
+//
+// Between begin() and commit() the batches of every tree are gathered into
+// one record, so a mutation that touches several trees (a row and its
+// secondary indexes) replays all or nothing. Only one transaction may be
+// open at a time; the caller's exclusive lock guarantees that.
+//
+// LSNs number the records ever appended, so they keep growing across
+// checkpoints even though the file itself is truncated. Inside a
+// transaction append() already returns the LSN the record will get.
+//
+// A failed write or fsync marks the log failed for good: after a failed
+// fsync the kernel may have dropped the pages, so retrying proves nothing.
+// The durable LSN stops where it was and every later wait reports failure.
+class WriteAheadLog {
+private:
+    string path;
+    int fd;
+    string pending;          // appended but not yet written
+    string transaction;      // payload of the open transaction
+    bool inTransaction;
+    uint64_t appended;       // LSN of the last record
+    atomic<uint64_t> durable;
+    size_t fileBytes;        // log size since the last truncate, pending included
+    bool flushing;
+    bool failed;
+    uint64_t commits;
+    uint64_t syncs;
+    uint64_t checkpoints;
+    mutex logMutex;
+    condition_variable flushed;
+
+    struct CRCTable {
+        uint32_t entries[256];
+
+        CRCTable() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+        }
+    };
+
+    // Frames a record into pending; logMutex must be held
+    void enqueue(const string& payload) {
+        uint32_t magic = WAL_BATCH_MAGIC;
+        uint32_t length = payload.size();
+        uint32_t checksum = crc32(payload.data(), payload.size());
+        pending.append((const char*)&magic, sizeof(magic));
+        pending.append((const char*)&length, sizeof(length));
+        pending.append(payload);
+        pending.append((const char*)&checksum, sizeof(checksum));
+        fileBytes += sizeof(magic) + sizeof(length) + payload.size() + sizeof(checksum);
+        appended++;
+        commits++;
+    }
+
+    static uint32_t crc32(const char* data, size_t length) {
+        static const CRCTable table;
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < length; i++) {
+            crc = table.entries[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    static int openFile(const string& file, bool create) {
+#ifdef _WIN32
+        return _open(file.c_str(), _O_RDWR | _O_BINARY | (create ? _O_CREAT : 0), _S_IREAD | _S_IWRITE);
+#else
+        return ::open(file.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+#endif
+    }
+
+    static void closeFile(int file) {
+#ifdef _WIN32
+        _close(file);
+#else
+        ::close(file);
+#endif
+    }
+
+    static bool writeAt(int file, long offset, const char* data, size_t length) {
+#ifdef _WIN32
+        if (_lseek(file, offset, SEEK_SET) < 0) return false;
+        while (length > 0) {
+            int n = _write(file, data, (unsigned)length);
+            if (n <= 0) return false;
+            data += n;
+            length -= n;
+        }
+#else
+        while (length > 0) {
+            ssize_t n = pwrite(file, data, length, offset);
+            if (n <= 0) return false;
+            data += n;
+            length -= n;
+            offset += n;
+        }
+#endif
+        return true;
+    }
+
+    static bool syncFile(int file) {
+#ifdef _WIN32
+        return _commit(file) == 0;
+#else
+        return fdatasync(file) == 0;
+#endif
+    }
+
+    static bool truncateFile(int file) {
+#ifdef _WIN32
+        return _chsize(file, 0) == 0;
+#else
+        return ftruncate(file, 0) == 0;
+#endif
+    }
+
+    static bool readFile(const string& file, string& contents) {
+        int in = openFile(file, false);
+        if (in < 0) return false;
+        char buffer[65536];
+        while (true) {
+#ifdef _WIN32
+            int n = _read(in, buffer, sizeof(buffer));
+#else
+            ssize_t n = ::read(in, buffer, sizeof(buffer));
+#endif
+            if (n <= 0) break;
+            contents.append(buffer, n);
+        }
+        closeFile(in);
+        return true;
+    }
+
+    template<typename T>
+    static bool readValue(const string& data, size_t& offset, size_t end, T& value) {
+        if (offset + sizeof(T) > end) return false;
+        memcpy(&value, data.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    static bool readName(const string& data, size_t& offset, size_t end, string& name) {
+        uint16_t length;
+        if (!readValue(data, offset, end, length) || offset + length > end) return false;
+        name.assign(data, offset, length);
+        offset += length;
+        return true;
+    }
+
+    // Applies every complete batch to the data files and syncs them; a torn
+    // or corrupt batch ends the log. False if any file could not be opened,
+    // written or synced, in which case the log must be kept.
+    static bool replay(const string& logPath) {
+        string log;
+        if (!readFile(logPath, log) || log.empty()) return true;
+
+        unordered_map<string, int> files;
+        bool ok = true;
+        size_t offset = 0;
+        while (true) {
+            uint32_t magic, length, checksum;
+            if (!readValue(log, offset, log.size(), magic) || magic != WAL_BATCH_MAGIC) break;
+            if (!readValue(log, offset, log.size(), length) || length > WAL_MAX_BATCH_SIZE) break;
+            size_t end = offset + length;
+            if (end + sizeof(uint32_t) > log.size()) break;
+            memcpy(&checksum, log.data() + end, sizeof(uint32_t));
+            if (crc32(log.data() + offset, length) != checksum) break;
+
+            while (offset < end) {
+                uint8_t type;
+                string name;
+                if (!readValue(log, offset, end, type) || !readName(log, offset, end, name)) break;
+
+                auto it = files.find(name);
+                if (it == files.end()) {
+                    it = files.emplace(name, openFile(name, true)).first;
+                }
+                int file = it->second;
+
+                if (type == WALBatch::ENTRY_PAGE) {
+                    FilePos pos;
+                    uint32_t size;
+                    if (!readValue(log, offset, end, pos) || !readValue(log, offset, end, size) || offset + size > end) break;
+                    ok = file >= 0 && writeAt(file, pos, log.data() + offset, size) && ok;
+                    offset += size;
+                } else if (type == WALBatch::ENTRY_HEADER) {
+                    if (offset + sizeof(FilePos) * 2 > end) break;
+                    ok = file >= 0 && writeAt(file, 0, log.data() + offset, sizeof(FilePos) * 2) && ok;
+                    offset += sizeof(FilePos) * 2;
+                } else {
+                    break;
+                }
+            }
+            offset = end + sizeof(uint32_t);
+        }
+
+        for (auto& entry : files) {
+            if (entry.second >= 0) {
+                ok = syncFile(entry.second) && ok;
+                closeFile(entry.second);
+            }
+        }
+        return ok;
+    }
+
+public:
+    // Replays whatever a previous run left in the log before anything opens
+    // the data files, then starts an empty log. Throws WALError, leaving the
+    // log as it was, if the replay or the fresh log cannot be made durable.
+    WriteAheadLog(const string& logPath)
+        : path(logPath), fd(-1), inTransaction(false), appended(0), durable(0), fileBytes(0), flushing(false),
+          failed(false), commits(0), syncs(0), checkpoints(0) {
+        if (!replay(path)) {
+            throw WALError("could not replay " + path + " into the data files");
+        }
+        fd = openFile(path, true);
+        if (fd < 0 || !truncateFile(fd) || !syncFile(fd)) {
+            throw WALError("could not reset " + path);
+        }
+    }
+
+    ~WriteAheadLog() {
+        flush();
+        if (fd >= 0) {
+            closeFile(fd);
+        }
+    }
+
+    // Queues a batch, or adds it to the open transaction; returns the LSN to wait for
+    uint64_t append(const WALBatch& batch) {
+        lock_guard<mutex> lock(logMutex);
+        if (inTransaction) {
+            transaction += batch.getPayload();
+            return appended + 1;
+        }
+        enqueue(batch.getPayload());
+        return appended;
+    }
+
+    void begin() {
+        lock_guard<mutex> lock(logMutex);
+        inTransaction = true;
+        transaction.clear();
+    }
+
+    // Queues the transaction as one record; returns the LSN to wait for
+    uint64_t commit() {
+        lock_guard<mutex> lock(logMutex);
+        inTransaction = false;
+        if (!transaction.empty()) {
+            enqueue(transaction);
+            transaction.clear();
+        }
+        return appended;
+    }
+
+    // Blocks until everything up to `lsn` is on disk; false if the log failed
+    // before getting there
+    bool waitDurable(uint64_t lsn) {
+        unique_lock<mutex> lock(logMutex);
+        while (durable.load() < lsn) {
+            if (failed) return false;
+            if (flushing) {
+                flushed.wait(lock);
+                continue;
+            }
+
+            // Become the leader: write out the whole group with one fsync
+            flushing = true;
+            string group;
+            group.swap(pending);
+            uint64_t target = appended;
+            size_t offset = fileBytes - group.size();
+            lock.unlock();
+
+            bool written = group.empty() || (fd >= 0 && writeAt(fd, offset, group.data(), group.size()) && syncFile(fd));
+
+            lock.lock();
+            syncs++;
+            if (written) {
+                durable.store(target);
+            } else {
+                failed = true;
+            }
+            flushing = false;
+            flushed.notify_all();
+        }
+        return true;
+    }
+
+    bool flush() {
+        uint64_t lsn;
+        {
+            lock_guard<mutex> lock(logMutex);
+            lsn = appended;
+        }
+        return waitDurable(lsn);
+    }
+
+    uint64_t appendedLsn() {
+        lock_guard<mutex> lock(logMutex);
+        return appended;
+    }
+
+    uint64_t durableLsn() const {
+        return durable.load();
+    }
+
+    bool needsCheckpoint() {
+        lock_guard<mutex> lock(logMutex);
+        return fileBytes > WAL_CHECKPOINT_SIZE;
+    }
+
+    // Call once every logged page has been written back and synced; no
+    // batch may be appended in between. On failure the log keeps its records.
+    bool truncate() {
+        if (!flush()) return false;
+        lock_guard<mutex> lock(logMutex);
+        if (fd < 0 || !truncateFile(fd)) return false;
+        fileBytes = 0;
+        checkpoints++;
+        if (!syncFile(fd)) {
+            failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    // fsyncs a file that is written through another handle (e.g. fstream)
+    static bool syncPath(const string& file) {
+        int handle = openFile(file, false);
+        if (handle < 0) return false;
+        bool synced = syncFile(handle);
+        closeFile(handle);
+        return synced;
+    }
+
+    WALStats getStats() {
+        lock_guard<mutex> lock(logMutex);
+        WALStats stats;
+        stats.commits = commits;
+        stats.syncs = syncs;
+        stats.checkpoints = checkpoints;
+        stats.bytes = fileBytes;
+        return stats;
+    }
+};
@@ -2,6 +2,7 @@
 
 #include <cstring>
 #include <ctime>
+#include <cstdint>
 
 using namespace std;
 
@@ -11,7 +12,7 @@ struct Log {
     int film_id;
     float rating;
     char review_preview[256];
-    long watch_date;
+    int32_t watch_date;         // Unix timestamp, 4 bytes on every platform
 
     Log() : log_id(0), user_id(0), film_id(0), rating(0.0f), watch_date(0) {
         memset(review_preview, 0, sizeof(review_preview));
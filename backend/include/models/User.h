@@ -2,6 +2,7 @@
 
 #include <cstring>
 #include <ctime>
+#include <cstdint>
 
 using namespace std;
 
@@ -11,7 +12,7 @@ struct User {
     char email[64];
     char password_hash[64];
     char bio[256];
-    long join_date;
+    int32_t join_date;          // Unix timestamp, 4 bytes on every platform
     bool isAdmin;
     int avatar_id;             // New: Profile avatar selection (1-10)
 
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <vector>
+#include <cerrno>
+
+using namespace std;
+
+// Thin wrapper around a Linux epoll instance (level-triggered)
+class EventLoop {
+private:
+    int epollFd;
+    vector<epoll_event> events;
+
+    bool control(int op, int fd, uint32_t mask) {
+        epoll_event ev;
+        ev.events = mask;
+        ev.data.fd = fd;
+        return epoll_ctl(epollFd, op, fd, &ev) == 0;
+    }
+
+public:
+    EventLoop(int maxEvents = 256) : epollFd(-1), events(maxEvents) {}
+
+    ~EventLoop() {
+        if (epollFd >= 0) {
+            close(epollFd);
+        }
+    }
+
+    bool open() {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        return epollFd >= 0;
+    }
+
+    bool add(int fd, uint32_t mask) {
+        return control(EPOLL_CTL_ADD, fd, mask);
+    }
+
+    bool modify(int fd, uint32_t mask) {
+        return control(EPOLL_CTL_MOD, fd, mask);
+    }
+
+    void remove(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    // Returns the number of ready descriptors, 0 on timeout or EINTR
+    int wait(int timeoutMs) {
+        int n = epoll_wait(epollFd, events.data(), events.size(), timeoutMs);
+        if (n < 0) {
+            return 0;
+        }
+        return n;
+    }
+
+    int readyFd(int i) const {
+        return events[i].data.fd;
+    }
+
+    uint32_t readyEvents(int i) const {
+        return events[i].events;
+    }
+
+    static bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0) return false;
+        return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+};
+
+#endif
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+
+#define MAX_HEADER_SIZE (16 * 1024)
+#define MAX_BODY_SIZE (1024 * 1024)
+
+struct HTTPHeader {
+    string_view name;
+    string_view value;
+};
+
+// A parsed request. Every view points into the connection's read buffer,
+// which must stay untouched until the request has been answered.
+struct HTTPRequest {
+    string_view method;
+    string_view path;
+    string_view version;
+    string_view body;
+    string_view authToken;
+    vector<HTTPHeader> headers;
+    bool keepAlive;
+
+    HTTPRequest() : keepAlive(false) {}
+
+    // ASCII-only comparison; header names and the tokens we match are plain ASCII
+    static bool equalsIgnoreCase(string_view a, string_view b) {
+        if (a.length() != b.length()) return false;
+        for (size_t i = 0; i < a.length(); i++) {
+            char x = a[i], y = b[i];
+            if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+            if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+            if (x != y) return false;
+        }
+        return true;
+    }
+
+    // Case-insensitive header lookup; empty view if absent
+    string_view header(string_view name) const {
+        for (const auto& h : headers) {
+            if (equalsIgnoreCase(h.name, name)) return h.value;
+        }
+        return string_view();
+    }
+};
+
+// Resumable HTTP/1.x request parser. The request starts at the front of the
+// buffer; call parse() with the whole buffer each time more bytes arrive and
+// scanning resumes where the previous call stopped, so no byte is examined
+// twice. Positions are kept as offsets because the buffer may be reallocated
+// between calls; views are built on completion.
+class HTTPParser {
+public:
+    enum State {
+        REQUEST_LINE,
+        HEADERS,
+        BODY,
+        COMPLETE,
+        ERROR
+    };
+
+private:
+    struct Span {
+        size_t start;
+        size_t length;
+    };
+
+    struct HeaderSpan {
+        Span name;
+        Span value;
+    };
+
+    State state;
+    size_t offset;       // next byte to scan
+    size_t lineStart;    // start of the line being scanned
+    size_t bodyStart;
+    size_t contentLength;
+    int errorStatus;
+
+    Span method;
+    Span path;
+    Span version;
+    vector<HeaderSpan> headerSpans;
+    int authHeader;       // index into headerSpans, -1 if absent
+    int connectionHeader;
+    HTTPRequest parsed;
+
+    static Span trim(const char* data, size_t start, size_t end) {
+        while (start < end && (data[start] == ' ' || data[start] == '\t')) start++;
+        while (end > start && (data[end - 1] == ' ' || data[end - 1] == '\t')) end--;
+        return {start, end - start};
+    }
+
+    static string_view view(const char* data, const Span& span) {
+        return string_view(data + span.start, span.length);
+    }
+
+    State fail(int status) {
+        errorStatus = status;
+        state = ERROR;
+        return state;
+    }
+
+    bool parseRequestLine(const char* data, size_t end) {
+        const char* line = data + lineStart;
+        size_t length = end - lineStart;
+        const char* firstSpace = (const char*)memchr(line, ' ', length);
+        if (!firstSpace) return false;
+        const char* secondSpace = (const char*)memchr(firstSpace + 1, ' ', line + length - firstSpace - 1);
+        if (!secondSpace) return false;
+
+        method = {lineStart, (size_t)(firstSpace - line)};
+        path = {(size_t)(firstSpace + 1 - data), (size_t)(secondSpace - firstSpace - 1)};
+        version = {(size_t)(secondSpace + 1 - data), (size_t)(line + length - secondSpace - 1)};
+        return method.length > 0 && path.length > 0 && version.length > 0;
+    }
+
+    bool parseHeaderLine(const char* data, size_t end) {
+        const char* line = data + lineStart;
+        const char* colon = (const char*)memchr(line, ':', end - lineStart);
+        if (!colon || colon == line) return false;
+
+        size_t colonPos = colon - data;
+        HeaderSpan header;
+        header.name = {lineStart, colonPos - lineStart};
+        header.value = trim(data, colonPos + 1, end);
+        headerSpans.push_back(header);
+
+        string_view name = view(data, header.name);
+        if (HTTPRequest::equalsIgnoreCase(name, "Authorization")) {
+            authHeader = headerSpans.size() - 1;
+        } else if (HTTPRequest::equalsIgnoreCase(name, "Connection")) {
+            connectionHeader = headerSpans.size() - 1;
+        } else if (HTTPRequest::equalsIgnoreCase(name, "Content-Length")) {
+            string_view value = view(data, header.value);
+            if (value.empty()) return false;
+            size_t length = 0;
+            for (char c : value) {
+                if (c < '0' || c > '9') return false;
+                length = length * 10 + (c - '0');
+                if (length > MAX_BODY_SIZE) {
+                    contentLength = length;
+                    return true; // rejected with 413 once the headers end
+                }
+            }
+            contentLength = length;
+        } else if (HTTPRequest::equalsIgnoreCase(name, "Transfer-Encoding")) {
+            errorStatus = 501; // chunked bodies are not supported
+        }
+        return true;
+    }
+
+    void buildRequest(const char* data) {
+        parsed.method = view(data, method);
+        parsed.path = view(data, path);
+        parsed.version = view(data, version);
+        parsed.body = string_view(data + bodyStart, contentLength);
+        parsed.headers.clear(); // keeps capacity across requests on the connection
+        for (const auto& span : headerSpans) {
+            parsed.headers.push_back({view(data, span.name), view(data, span.value)});
+        }
+        parsed.authToken = authHeader >= 0 ? parsed.headers[authHeader].value : string_view();
+
+        // HTTP/1.1 connections persist unless the client asks to close
+        parsed.keepAlive = (parsed.version == "HTTP/1.1");
+        string_view connection = connectionHeader >= 0 ? parsed.headers[connectionHeader].value : string_view();
+        if (HTTPRequest::equalsIgnoreCase(connection, "close")) {
+            parsed.keepAlive = false;
+        } else if (HTTPRequest::equalsIgnoreCase(connection, "keep-alive")) {
+            parsed.keepAlive = true;
+        }
+    }
+
+public:
+    HTTPParser() {
+        reset();
+    }
+
+    void reset() {
+        state = REQUEST_LINE;
+        offset = 0;
+        lineStart = 0;
+        bodyStart = 0;
+        contentLength = 0;
+        errorStatus = 0;
+        authHeader = -1;
+        connectionHeader = -1;
+        headerSpans.clear();
+    }
+
+    State parse(const char* data, size_t length) {
+        while (state == REQUEST_LINE || state == HEADERS) {
+            const char* newline = (const char*)memchr(data + offset, '\n', length - offset);
+            if (!newline) {
+                offset = length;
+                if (offset > MAX_HEADER_SIZE) return fail(431);
+                return state;
+            }
+
+            size_t lineEnd = newline - data;
+            offset = lineEnd + 1;
+            if (offset > MAX_HEADER_SIZE) return fail(431);
+            size_t end = (lineEnd > lineStart && data[lineEnd - 1] == '\r') ? lineEnd - 1 : lineEnd;
+
+            if (state == REQUEST_LINE) {
+                if (end == lineStart) {
+                    lineStart = offset; // tolerate blank lines between pipelined requests
+                    continue;
+                }
+                if (!parseRequestLine(data, end)) return fail(400);
+                state = HEADERS;
+            } else if (end == lineStart) {
+                if (errorStatus != 0) return fail(errorStatus);
+                if (contentLength > MAX_BODY_SIZE) return fail(413);
+                bodyStart = offset;
+                state = BODY;
+            } else if (!parseHeaderLine(data, end)) {
+                return fail(400);
+            }
+            lineStart = offset;
+        }
+
+        if (state == BODY && length - bodyStart >= contentLength) {
+            offset = bodyStart + contentLength;
+            buildRequest(data);
+            state = COMPLETE;
+        }
+        return state;
+    }
+
+    State getState() const {
+        return state;
+    }
+
+    // Valid once parse() returned COMPLETE
+    const HTTPRequest& request() const {
+        return parsed;
+    }
+
+    // Bytes taken by the completed request; pipelined data follows
+    size_t consumed() const {
+        return offset;
+    }
+
+    // HTTP status to answer with when parse() returned ERROR
+    int getErrorStatus() const {
+        return errorStatus;
+    }
+};
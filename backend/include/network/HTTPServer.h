@@ -1,92 +1,129 @@
 #pragma once
 
 #include "../service/ServiceController.h"
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#include "../utils/ThreadPool.h"
+#include "HTTPParser.h"
+#include "Router.h"
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <thread>
 
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #pragma comment(lib, "ws2_32.lib")
+#else
+#include "EventLoop.h"
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <cstdint>
+
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#endif
 
 using namespace std;
 
-struct HTTPRequest {
-    string method;
-    string path;
-    string body;
-    string authToken;
+#define MAX_REQUEST_SIZE (MAX_HEADER_SIZE + MAX_BODY_SIZE)
+#define READ_CHUNK_SIZE 16384
+#define KEEP_ALIVE_TIMEOUT_SECONDS 5
+// Write handlers block on the WAL fsync, so keep enough workers around for
+// concurrent commits to share one sync even on small machines
+#define MIN_WORKER_THREADS 8
+
+#ifndef _WIN32
+// Per-socket state for the epoll loop
+struct Connection {
+    int fd;
+    uint64_t id;        // distinguishes reuse of the same fd number
+    bool busy;          // a worker thread owns the current request
+    bool closing;       // peer went away while busy; freed once the worker finishes
+    bool keepAlive;     // whether the in-flight request allows reuse
+    HTTPParser parser;
+    string readBuffer;  // parsed requests are views into this buffer
+    string writeBuffer;
+    size_t writeOffset;
+    chrono::steady_clock::time_point lastActive;
+
+    Connection(int f, uint64_t i) : fd(f), id(i), busy(false), closing(false), keepAlive(false), writeOffset(0),
+                                    lastActive(chrono::steady_clock::now()) {}
 };
 
+// Response produced by a worker, handed back to the event loop thread
+struct Completion {
+    int fd;
+    uint64_t connectionId;
+    string response;
+};
+#endif
+
 class HTTPServer {
 private:
+    typedef string (HTTPServer::*RouteHandler)(const HTTPRequest&, const RouteParams&, const QueryParams&, const RequestContext&);
+
     int port;
     SOCKET serverSocket;
     ServiceController* controller;
     bool running;
+    ThreadPool* workers;
+    Router<RouteHandler> router;
+#ifndef _WIN32
+    EventLoop eventLoop;
+    unordered_map<int, Connection*> connections;
+    uint64_t nextConnectionId;
+    int wakeFd; // eventfd the workers signal when completions are queued
+    int spareFd; // held in reserve so a connection can be shed when out of descriptors
+    bool acceptPaused; // listener taken out of epoll until accepting can work again
+    mutex completionMutex;
+    vector<Completion> completions;
+    chrono::steady_clock::time_point lastIdleSweep;
+#endif
 
-    HTTPRequest parseRequest(const string& rawRequest) {
-        HTTPRequest req;
-        istringstream stream(rawRequest);
-        stream >> req.method >> req.path;
-        
-        // Extract Authorization header
-        size_t authPos = rawRequest.find("Authorization:");
-        if (authPos != string::npos) {
-            size_t authStart = authPos + 14; // Skip "Authorization:"
-            while (authStart < rawRequest.length() && rawRequest[authStart] == ' ') {
-                authStart++;
-            }
-            if (authStart < rawRequest.length()) {
-                size_t authEnd = rawRequest.find("\r\n", authStart);
-                if (authEnd != string::npos) {
-                    req.authToken = rawRequest.substr(authStart, authEnd - authStart);
-                }
-            }
-        }
-        
-        size_t bodyStart = rawRequest.find("\r\n\r\n");
-        if (bodyStart != string::npos) {
-            req.body = rawRequest.substr(bodyStart + 4);
-        }
-        
-        return req;
-    }
-    
-    void setAuthFromToken(const string& token) {
+    // Token format: "userId:username:isAdmin"
+    RequestContext contextFromToken(string_view token) {
         if (token.empty()) {
-            controller->setCurrentUser(0, false, false);
-            return;
+            return RequestContext();
         }
         
-        // Token format: "userId:username:isAdmin"
         size_t firstColon = token.find(':');
         if (firstColon == string::npos) {
-            controller->setCurrentUser(0, false, false);
-            return;
+            return RequestContext();
         }
         
         size_t secondColon = token.find(':', firstColon + 1);
         if (secondColon == string::npos) {
-            controller->setCurrentUser(0, false, false);
-            return;
+            return RequestContext();
         }
         
         try {
-            int userId = stoi(token.substr(0, firstColon));
+            int userId = stoi(string(token.substr(0, firstColon)));
             bool isAdmin = (token.substr(secondColon + 1) == "1");
-            controller->setCurrentUser(userId, true, isAdmin);
+            return RequestContext(userId, true, isAdmin);
         } catch (...) {
-            controller->setCurrentUser(0, false, false);
+            return RequestContext();
         }
     }
 
-    string parseJsonField(const string& json, const string& field) {
+    string parseJsonField(string_view json, const string& field) {
         size_t pos = json.find("\"" + field + "\"");
         if (pos == string::npos) return "";
         
-        size_t valueStart = json.find(":", pos) + 1;
-        while (json[valueStart] == ' ' || json[valueStart] == '\"') valueStart++;
+        size_t colon = json.find(":", pos);
+        if (colon == string::npos) return "";
+        size_t valueStart = colon + 1;
+        while (valueStart < json.length() && (json[valueStart] == ' ' || json[valueStart] == '\"')) valueStart++;
+        if (valueStart >= json.length()) return "";
         
         size_t valueEnd = valueStart;
         if (json[valueStart - 1] == '\"') {
@@ -95,10 +132,10 @@ private:
             valueEnd = json.find_first_of(",}", valueStart);
         }
         
-        return json.substr(valueStart, valueEnd - valueStart);
+        return string(json.substr(valueStart, valueEnd - valueStart));
     }
 
-    int parseJsonInt(const string& json, const string& field) {
+    int parseJsonInt(string_view json, const string& field) {
         string value = parseJsonField(json, field);
         try {
             return stoi(value);
@@ -107,7 +144,7 @@ private:
         }
     }
 
-    float parseJsonFloat(const string& json, const string& field) {
+    float parseJsonFloat(string_view json, const string& field) {
         string value = parseJsonField(json, field);
         try {
             return stof(value);
@@ -116,267 +153,603 @@ private:
         }
     }
 
-    string buildHTTPResponse(int statusCode, const string& statusText, const string& body) {
+    static const char* statusText(int statusCode) {
+        switch (statusCode) {
+            case 200: return "OK";
+            case 304: return "Not Modified";
+            case 400: return "Bad Request";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 413: return "Payload Too Large";
+            case 431: return "Request Header Fields Too Large";
+            case 500: return "Internal Server Error";
+            case 501: return "Not Implemented";
+            default: return "Error";
+        }
+    }
+
+    // Response for a request the parser rejected; the connection is closed after it
+    string buildErrorResponse(int statusCode) {
+        HTTPRequest req;
+        return buildHTTPResponse(req, statusCode, statusText(statusCode),
+                                 "{\"status\":\"error\",\"message\":\"" + string(statusText(statusCode)) + "\"}");
+    }
+
+    // extraHeaders are complete "Name: value\r\n" lines
+    string buildHTTPResponse(const HTTPRequest& req, int statusCode, const string& statusText, const string& body,
+                             const string& extraHeaders = "") {
         ostringstream response;
         response << "HTTP/1.1 " << statusCode << " " << statusText << "\r\n";
-        response << "Content-Type: application/json\r\n";
-        response << "Content-Length: " << body.length() << "\r\n";
+        if (statusCode != 304) {
+            response << "Content-Type: application/json\r\n";
+            response << "Content-Length: " << body.length() << "\r\n";
+        }
+        response << extraHeaders;
+        if (req.keepAlive) {
+            response << "Connection: keep-alive\r\n";
+            response << "Keep-Alive: timeout=" << KEEP_ALIVE_TIMEOUT_SECONDS << "\r\n";
+        } else {
+            response << "Connection: close\r\n";
+        }
         response << "Access-Control-Allow-Origin: *\r\n";
         response << "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n";
-        response << "Access-Control-Allow-Headers: Content-Type, Authorization\r\n";
+        response << "Access-Control-Allow-Headers: Content-Type, Authorization, If-None-Match\r\n";
         response << "\r\n";
         response << body;
         return response.str();
     }
 
+    // True if an If-None-Match list names etag (weak prefixes ignored, as
+    // the header compares weakly) or is "*"
+    static bool etagMatches(string_view ifNoneMatch, const string& etag) {
+        size_t pos = 0;
+        while (pos < ifNoneMatch.size()) {
+            size_t end = ifNoneMatch.find(',', pos);
+            if (end == string_view::npos) end = ifNoneMatch.size();
+            string_view tag = ifNoneMatch.substr(pos, end - pos);
+            while (!tag.empty() && tag.front() == ' ') tag.remove_prefix(1);
+            while (!tag.empty() && tag.back() == ' ') tag.remove_suffix(1);
+            if (tag.substr(0, 2) == "W/") tag.remove_prefix(2);
+            if (tag == "*" || tag == etag) return true;
+            pos = end + 1;
+        }
+        return false;
+    }
+
+    // 200 with the cached body, or a bodiless 304 if the client has it
+    string buildCachedResponse(const HTTPRequest& req, const CachedResponse& cached) {
+        string headers = "ETag: " + cached.etag + "\r\nCache-Control: no-cache\r\n" +
+                         "Access-Control-Expose-Headers: ETag\r\n";
+        if (etagMatches(req.header("If-None-Match"), cached.etag)) {
+            return buildHTTPResponse(req, 304, "Not Modified", "", headers);
+        }
+        return buildHTTPResponse(req, 200, "OK", cached.body, headers);
+    }
+
+    // Authentication endpoints
+    string handleLogin(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string username = parseJsonField(req.body, "username");
+        string password = parseJsonField(req.body, "password");
+        string result = controller->loginUser(ctx, username, password);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleRegister(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string username = parseJsonField(req.body, "username");
+        string email = parseJsonField(req.body, "email");
+        string password = parseJsonField(req.body, "password");
+        string bio = parseJsonField(req.body, "bio");
+        string result = controller->registerUser(ctx, username, email, password, bio);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    // Film endpoints
+    string handleGetFilms(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        return buildCachedResponse(req, *controller->getAllFilms(ctx));
+    }
+
+    string handleGetFilm(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->getFilmById(ctx, params.getInt("filmId"));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    // Log endpoints
+    string handleAddLog(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        int filmId = parseJsonInt(req.body, "film_id");
+        float rating = parseJsonFloat(req.body, "rating");
+        string review = parseJsonField(req.body, "review_text");
+        
+        string result = controller->addLog(ctx, filmId, rating, review);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleGetUserLogs(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        // Optional ?from=&to= watch_date range (Unix seconds, to exclusive)
+        string result = controller->getUserLogs(ctx, params.getInt("userId"), query.getInt("from", INT32_MIN),
+                                                query.getInt("to", INT32_MAX));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleRecentLogs(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        int limit = max(1, min(query.getInt("limit", 10), 100));
+        string result = controller->getRecentLogs(ctx, limit, query.getInt("from", INT32_MIN),
+                                                  query.getInt("to", INT32_MAX));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    // Interaction endpoints
+    string handleInteraction(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        int filmId = parseJsonInt(req.body, "film_id");
+        int type = parseJsonInt(req.body, "type");
+        
+        string result = controller->toggleInteraction(ctx, filmId, type);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleWatchlist(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->getUserWatchlist(ctx, params.getInt("userId"));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleFavorites(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->getUserFavorites(ctx, params.getInt("userId"));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleProfile(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->getUserProfile(ctx, params.getInt("userId"));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    // Home data
+    string handleHomeData(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->getHomeData(ctx);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    // Genres
+    string handleGenres(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        return buildCachedResponse(req, *controller->getAllGenres(ctx));
+    }
+
+    // Social endpoints
+    string handleFollow(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        int targetId = parseJsonInt(req.body, "target_id");
+        string result = controller->followUser(ctx, targetId);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleUnfollow(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        int targetId = parseJsonInt(req.body, "target_id");
+        string result = controller->unfollowUser(ctx, targetId);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleSocial(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->getUserSocial(ctx, params.getInt("userId"));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleNetwork(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->getUserNetwork(ctx, params.getInt("userId"));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleSuggestions(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        int limit = max(1, min(query.getInt("limit", 10), SUGGESTION_CACHE_RESULTS));
+        string result = controller->getUserSuggestions(ctx, params.getInt("userId"), limit);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    // Search: /api/search?q=...&type=user
+    string handleSearch(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        if (!query.has("q")) {
+            return buildHTTPResponse(req, 400, "Bad Request", "{\"status\":\"error\",\"message\":\"Invalid query\"}");
+        }
+
+        string text = QueryParams::decode(query.get("q"));
+        string result;
+        if (query.get("type") == "user") {
+            result = controller->searchUsers(ctx, text);
+        } else if (query.get("type") == "fuzzy") {
+            int limit = max(1, min(query.getInt("limit", SEARCH_TOP_K), SEARCH_TOP_K));
+            result = controller->fuzzySearchFilms(ctx, text, limit);
+        } else if (query.get("type") == "substring") {
+            int limit = max(1, min(query.getInt("limit", SEARCH_TOP_K), SEARCH_TOP_K));
+            result = controller->searchSubstring(ctx, text, limit);
+        } else if (query.get("type") == "text") {
+            int limit = max(1, min(query.getInt("limit", SEARCH_TOP_K), SEARCH_TOP_K));
+            result = controller->textSearchFilms(ctx, text, limit);
+        } else {
+            int limit = max(1, min(query.getInt("limit", SEARCH_TOP_K), SEARCH_TOP_K));
+            result = controller->searchFilms(ctx, text, limit);
+        }
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    // Admin endpoints
+    string handleAdminUsers(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->adminGetAllUsers(ctx);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleAdminAddFilm(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string title = parseJsonField(req.body, "title");
+        int year = parseJsonInt(req.body, "year");
+        int runtime = parseJsonInt(req.body, "runtime");
+        float rating = parseJsonFloat(req.body, "rating");
+        string director = parseJsonField(req.body, "director");
+        string cast = parseJsonField(req.body, "cast");
+        string tagline = parseJsonField(req.body, "tagline");
+        string overview = parseJsonField(req.body, "overview");
+        string posterPath = parseJsonField(req.body, "poster_path");
+        string backdropPath = parseJsonField(req.body, "backdrop_path");
+        
+        vector<int> genreIds;
+        // Parse genre_ids array if present
+        size_t genrePos = req.body.find("\"genre_ids\":[");
+        if (genrePos != string::npos) {
+            size_t genreStart = genrePos + 13;
+            size_t genreEnd = req.body.find("]", genreStart);
+            if (genreEnd != string::npos) {
+                string genreStr(req.body.substr(genreStart, genreEnd - genreStart));
+                istringstream genreStream(genreStr);
+                string item;
+                while (getline(genreStream, item, ',')) {
+                    try {
+                        genreIds.push_back(stoi(item));
+                    } catch (...) {}
+                }
+            }
+        }
+        
+        string result = controller->adminAddFilm(ctx, title, year, runtime, rating, director, cast, tagline, overview, posterPath, backdropPath, genreIds);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleAdminDeleteFilm(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->adminDeleteFilm(ctx, params.getInt("filmId"));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleAdminDeleteUser(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->adminDeleteUser(ctx, params.getInt("userId"));
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    string handleAdminStats(const HTTPRequest& req, const RouteParams& params, const QueryParams& query, const RequestContext& ctx) {
+        string result = controller->adminGetStorageStats(ctx);
+        return buildHTTPResponse(req, 200, "OK", result);
+    }
+
+    void registerRoutes() {
+        router.add(METHOD_POST, "/api/login", &HTTPServer::handleLogin);
+        router.add(METHOD_POST, "/api/register", &HTTPServer::handleRegister);
+
+        router.add(METHOD_GET, "/api/films", &HTTPServer::handleGetFilms);
+        router.add(METHOD_GET, "/api/film/{filmId:int}", &HTTPServer::handleGetFilm);
+
+        router.add(METHOD_POST, "/api/logs", &HTTPServer::handleAddLog);
+        router.add(METHOD_GET, "/api/logs/recent", &HTTPServer::handleRecentLogs);
+        router.add(METHOD_GET, "/api/user/{userId:int}/logs", &HTTPServer::handleGetUserLogs);
+
+        router.add(METHOD_POST, "/api/interaction", &HTTPServer::handleInteraction);
+        router.add(METHOD_GET, "/api/user/{userId:int}/watchlist", &HTTPServer::handleWatchlist);
+        router.add(METHOD_GET, "/api/user/{userId:int}/favorites", &HTTPServer::handleFavorites);
+        router.add(METHOD_GET, "/api/user/{userId:int}/profile", &HTTPServer::handleProfile);
+
+        router.add(METHOD_GET, "/api/home_data", &HTTPServer::handleHomeData);
+        router.add(METHOD_GET, "/api/genres", &HTTPServer::handleGenres);
+
+        router.add(METHOD_POST, "/api/social/follow", &HTTPServer::handleFollow);
+        router.add(METHOD_POST, "/api/social/unfollow", &HTTPServer::handleUnfollow);
+        router.add(METHOD_GET, "/api/user/{userId:int}/social", &HTTPServer::handleSocial);
+        router.add(METHOD_GET, "/api/user/{userId:int}/network", &HTTPServer::handleNetwork);
+        router.add(METHOD_GET, "/api/user/{userId:int}/suggestions", &HTTPServer::handleSuggestions);
+
+        router.add(METHOD_GET, "/api/search", &HTTPServer::handleSearch);
+
+        router.add(METHOD_GET, "/api/admin/users", &HTTPServer::handleAdminUsers);
+        router.add(METHOD_GET, "/api/admin/stats", &HTTPServer::handleAdminStats);
+        router.add(METHOD_POST, "/api/admin/film", &HTTPServer::handleAdminAddFilm);
+        router.add(METHOD_DELETE, "/api/admin/film/{filmId:int}", &HTTPServer::handleAdminDeleteFilm);
+        router.add(METHOD_DELETE, "/api/admin/user/{userId:int}", &HTTPServer::handleAdminDeleteUser);
+    }
+
     string handleRequest(const HTTPRequest& req) {
         cout << req.method << " " << req.path << endl;
 
         if (req.method == "OPTIONS") {
-            return buildHTTPResponse(200, "OK", "");
+            return buildHTTPResponse(req, 200, "OK", "");
+        }
+
+        RouteMatch<RouteHandler> match;
+        switch (router.match(req.method, req.path, match)) {
+            case Router<RouteHandler>::MATCHED: {
+                RequestContext ctx = contextFromToken(req.authToken);
+                return (this->*match.handler)(req, match.params, match.query, ctx);
+            }
+            case Router<RouteHandler>::METHOD_NOT_ALLOWED:
+                return buildHTTPResponse(req, 405, "Method Not Allowed", "{\"status\":\"error\",\"message\":\"Method not allowed\"}");
+            default:
+                return buildHTTPResponse(req, 404, "Not Found", "{\"status\":\"error\",\"message\":\"Endpoint not found\"}");
         }
+    }
 
-        // Authentication endpoints
-        if (req.path == "/api/login" && req.method == "POST") {
-            string username = parseJsonField(req.body, "username");
-            string password = parseJsonField(req.body, "password");
-            string result = controller->loginUser(username, password);
-            return buildHTTPResponse(200, "OK", result);
+    // Runs on a worker thread; a handler exception must not take the process down
+    string handleRequestSafely(const HTTPRequest& req) {
+        try {
+            return handleRequest(req);
+        } catch (const WALError&) {
+            return buildHTTPResponse(req, 500, "Internal Server Error",
+                                     "{\"status\":\"error\",\"message\":\"The change could not be saved\"}");
+        } catch (...) {
+            return buildHTTPResponse(req, 400, "Bad Request", "{\"status\":\"error\",\"message\":\"Malformed request\"}");
         }
-        else if (req.path == "/api/register" && req.method == "POST") {
-            string username = parseJsonField(req.body, "username");
-            string email = parseJsonField(req.body, "email");
-            string password = parseJsonField(req.body, "password");
-            string bio = parseJsonField(req.body, "bio");
-            string result = controller->registerUser(username, email, password, bio);
-            return buildHTTPResponse(200, "OK", result);
+    }
+
+#ifndef _WIN32
+    void acceptConnections() {
+        while (true) {
+            int clientSocket = accept(serverSocket, NULL, NULL);
+            if (clientSocket < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return; // backlog drained
+                }
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if ((errno == EMFILE || errno == ENFILE) && shedConnection()) {
+                    continue;
+                }
+                // The listener is level-triggered and stays readable while
+                // nothing can be accepted; stop watching it rather than spin
+                eventLoop.remove(serverSocket);
+                acceptPaused = true;
+                return;
+            }
+
+            EventLoop::setNonBlocking(clientSocket);
+            if (!eventLoop.add(clientSocket, EPOLLIN)) {
+                close(clientSocket);
+                continue;
+            }
+            connections[clientSocket] = new Connection(clientSocket, nextConnectionId++);
         }
-        
-        // Film endpoints
-        else if (req.path == "/api/films" && req.method == "GET") {
-            string result = controller->getAllFilms();
-            return buildHTTPResponse(200, "OK", result);
+    }
+
+    // Out of descriptors: frees the spare to accept the oldest pending
+    // connection and close it at once, so the backlog keeps moving
+    bool shedConnection() {
+        if (spareFd < 0) return false;
+        close(spareFd);
+        int shed = accept(serverSocket, NULL, NULL);
+        if (shed >= 0) close(shed);
+        spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        return shed >= 0 && spareFd >= 0;
+    }
+
+    void resumeAccepting() {
+        if (acceptPaused && eventLoop.add(serverSocket, EPOLLIN)) {
+            acceptPaused = false;
         }
-        else if (req.path.find("/api/film/") == 0 && req.method == "GET") {
-            setAuthFromToken(req.authToken);
-            int filmId = stoi(req.path.substr(10));
-            string result = controller->getFilmById(filmId);
-            return buildHTTPResponse(200, "OK", result);
+    }
+
+    void closeConnection(Connection* conn) {
+        eventLoop.remove(conn->fd);
+        if (conn->busy) {
+            // The worker still holds views into readBuffer; keep the fd number
+            // reserved and free everything when its completion arrives
+            conn->closing = true;
+            return;
         }
-        
-        // Log endpoints
-        else if (req.path == "/api/logs" && req.method == "POST") {
-            setAuthFromToken(req.authToken);
-            int filmId = parseJsonInt(req.body, "film_id");
-            float rating = parseJsonFloat(req.body, "rating");
-            string review = parseJsonField(req.body, "review_text");
-            
-            string result = controller->addLog(filmId, rating, review);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path.find("/api/user/") == 0 && req.path.find("/logs") != string::npos && req.method == "GET") {
-            size_t userStart = 10; // "/api/user/"
-            size_t userEnd = req.path.find("/", userStart);
-            int userId = stoi(req.path.substr(userStart, userEnd - userStart));
-            string result = controller->getUserLogs(userId);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path == "/api/logs/recent" && req.method == "GET") {
-            string result = controller->getRecentLogs(10);
-            return buildHTTPResponse(200, "OK", result);
+        close(conn->fd);
+        connections.erase(conn->fd);
+        delete conn;
+        resumeAccepting();
+    }
+
+    void onReadable(Connection* conn) {
+        // recv straight into the connection buffer; the parser works in place
+        while (conn->readBuffer.length() < MAX_REQUEST_SIZE) {
+            size_t used = conn->readBuffer.length();
+            conn->readBuffer.resize(used + READ_CHUNK_SIZE);
+            ssize_t bytesReceived = recv(conn->fd, &conn->readBuffer[used], READ_CHUNK_SIZE, 0);
+            conn->readBuffer.resize(used + (bytesReceived > 0 ? bytesReceived : 0));
+
+            if (bytesReceived > 0) {
+                continue;
+            }
+            if (bytesReceived < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            closeConnection(conn); // peer closed or hard error
+            return;
         }
-        
-        // Interaction endpoints
-        else if (req.path == "/api/interaction" && req.method == "POST") {
-            setAuthFromToken(req.authToken);
-            int filmId = parseJsonInt(req.body, "film_id");
-            int type = parseJsonInt(req.body, "type");
-            
-            string result = controller->toggleInteraction(filmId, type);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path.find("/api/user/") == 0 && req.path.find("/watchlist") != string::npos && req.method == "GET") {
-            size_t userStart = 10;
-            size_t userEnd = req.path.find("/", userStart);
-            int userId = stoi(req.path.substr(userStart, userEnd - userStart));
-            string result = controller->getUserWatchlist(userId);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path.find("/api/user/") == 0 && req.path.find("/favorites") != string::npos && req.method == "GET") {
-            size_t userStart = 10;
-            size_t userEnd = req.path.find("/", userStart);
-            int userId = stoi(req.path.substr(userStart, userEnd - userStart));
-            string result = controller->getUserFavorites(userId);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path.find("/api/user/") == 0 && req.path.find("/profile") != string::npos && req.method == "GET") {
-            size_t userStart = 10;
-            size_t userEnd = req.path.find("/", userStart);
-            int userId = stoi(req.path.substr(userStart, userEnd - userStart));
-            string result = controller->getUserProfile(userId);
-            return buildHTTPResponse(200, "OK", result);
+
+        conn->lastActive = chrono::steady_clock::now();
+        dispatchRequest(conn);
+    }
+
+    // Hands the next buffered request to a worker. Pipelined requests are
+    // served one at a time so responses go out in request order.
+    void dispatchRequest(Connection* conn) {
+        HTTPParser::State state = conn->parser.parse(conn->readBuffer.data(), conn->readBuffer.length());
+        if (state == HTTPParser::ERROR) {
+            conn->keepAlive = false;
+            conn->writeBuffer = buildErrorResponse(conn->parser.getErrorStatus());
+            conn->writeOffset = 0;
+            onWritable(conn);
+            return;
         }
-        
-        // Home data
-        else if (req.path == "/api/home_data" && req.method == "GET") {
-            string result = controller->getHomeData();
-            return buildHTTPResponse(200, "OK", result);
+        if (state != HTTPParser::COMPLETE) {
+            return; // wait for the rest of the request
         }
-        
-        // Genres
-        else if (req.path == "/api/genres" && req.method == "GET") {
-            string result = controller->getAllGenres();
-            return buildHTTPResponse(200, "OK", result);
+
+        conn->busy = true;
+        eventLoop.modify(conn->fd, 0); // readBuffer must not move while the worker reads it
+
+        HTTPRequest req = conn->parser.request();
+        conn->keepAlive = req.keepAlive;
+        int fd = conn->fd;
+        uint64_t connectionId = conn->id;
+        workers->submit([this, fd, connectionId, req]() {
+            string response = handleRequestSafely(req);
+            {
+                lock_guard<mutex> lock(completionMutex);
+                completions.push_back({fd, connectionId, move(response)});
+            }
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        });
+    }
+
+    void drainCompletions() {
+        uint64_t counter;
+        ssize_t ignored = read(wakeFd, &counter, sizeof(counter));
+        (void)ignored;
+
+        vector<Completion> ready;
+        {
+            lock_guard<mutex> lock(completionMutex);
+            ready.swap(completions);
         }
-        
-        // Social endpoints
-        else if (req.path == "/api/social/follow" && req.method == "POST") {
-            setAuthFromToken(req.authToken);
-            int targetId = parseJsonInt(req.body, "target_id");
-            string result = controller->followUser(targetId);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path == "/api/social/unfollow" && req.method == "POST") {
-            setAuthFromToken(req.authToken);
-            int targetId = parseJsonInt(req.body, "target_id");
-            string result = controller->unfollowUser(targetId);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path.find("/api/user/") == 0 && req.path.find("/social") != string::npos && req.method == "GET") {
-            size_t userStart = 10;
-            size_t userEnd = req.path.find("/", userStart);
-            int userId = stoi(req.path.substr(userStart, userEnd - userStart));
-            setAuthFromToken(req.authToken);
-            string result = controller->getUserSocial(userId);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path.find("/api/user/") == 0 && req.path.find("/network") != string::npos && req.method == "GET") {
-            size_t userStart = 10;
-            size_t userEnd = req.path.find("/", userStart);
-            int userId = stoi(req.path.substr(userStart, userEnd - userStart));
-            string result = controller->getUserNetwork(userId);
-            return buildHTTPResponse(200, "OK", result);
+
+        for (auto& completion : ready) {
+            auto it = connections.find(completion.fd);
+            if (it == connections.end() || it->second->id != completion.connectionId) {
+                continue; // client went away while the worker was busy
+            }
+            Connection* conn = it->second;
+            conn->busy = false;
+            if (conn->closing) {
+                closeConnection(conn);
+                continue;
+            }
+            conn->writeBuffer = move(completion.response);
+            conn->writeOffset = 0;
+            onWritable(conn);
         }
-        
-        // User search endpoint
-        else if (req.path.find("/api/search?") == 0 && req.method == "GET") {
-            size_t qPos = req.path.find("q=");
-            size_t typePos = req.path.find("type=");
-            
-            if (qPos != string::npos) {
-                size_t qEnd = req.path.find("&", qPos);
-                if (qEnd == string::npos) qEnd = req.path.length();
-                string query = req.path.substr(qPos + 2, qEnd - (qPos + 2));
-                
-                // URL decode
-                size_t pos = 0;
-                while ((pos = query.find("%20")) != string::npos) {
-                    query.replace(pos, 3, " ");
-                }
-                
-                // Check search type
-                string result;
-                if (typePos != string::npos) {
-                    string type = req.path.substr(typePos + 5);
-                    if (type == "user" || type.find("user") == 0) {
-                        result = controller->searchUsers(query);
-                    } else {
-                        result = controller->searchFilms(query);
-                    }
-                } else {
-                    result = controller->searchFilms(query);
-                }
-                
-                return buildHTTPResponse(200, "OK", result);
+    }
+
+    void onWritable(Connection* conn) {
+        while (conn->writeOffset < conn->writeBuffer.length()) {
+            ssize_t sent = send(conn->fd, conn->writeBuffer.data() + conn->writeOffset,
+                                conn->writeBuffer.length() - conn->writeOffset, MSG_NOSIGNAL);
+            if (sent > 0) {
+                conn->writeOffset += sent;
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                eventLoop.modify(conn->fd, EPOLLOUT);
+                return;
             }
-            return buildHTTPResponse(400, "Bad Request", "{\"status\":\"error\",\"message\":\"Invalid query\"}");
+            closeConnection(conn);
+            return;
         }
-        
-        // Admin endpoints
-        else if (req.path == "/api/admin/users" && req.method == "GET") {
-            setAuthFromToken(req.authToken);
-            string result = controller->adminGetAllUsers();
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path == "/api/admin/film" && req.method == "POST") {
-            setAuthFromToken(req.authToken);
-            
-            string title = parseJsonField(req.body, "title");
-            int year = parseJsonInt(req.body, "year");
-            int runtime = parseJsonInt(req.body, "runtime");
-            float rating = parseJsonFloat(req.body, "rating");
-            string director = parseJsonField(req.body, "director");
-            string cast = parseJsonField(req.body, "cast");
-            string tagline = parseJsonField(req.body, "tagline");
-            string overview = parseJsonField(req.body, "overview");
-            string posterPath = parseJsonField(req.body, "poster_path");
-            string backdropPath = parseJsonField(req.body, "backdrop_path");
-            
-            vector<int> genreIds;
-            // Parse genre_ids array if present
-            size_t genrePos = req.body.find("\"genre_ids\":[");
-            if (genrePos != string::npos) {
-                size_t genreStart = genrePos + 13;
-                size_t genreEnd = req.body.find("]", genreStart);
-                if (genreEnd != string::npos) {
-                    string genreStr = req.body.substr(genreStart, genreEnd - genreStart);
-                    istringstream genreStream(genreStr);
-                    string item;
-                    while (getline(genreStream, item, ',')) {
-                        try {
-                            genreIds.push_back(stoi(item));
-                        } catch (...) {}
-                    }
-                }
+
+        if (!conn->keepAlive) {
+            closeConnection(conn);
+            return;
+        }
+
+        // Response done: serve the next pipelined request or wait for more input
+        conn->readBuffer.erase(0, conn->parser.consumed());
+        conn->parser.reset();
+        conn->writeBuffer.clear();
+        conn->writeOffset = 0;
+        conn->lastActive = chrono::steady_clock::now();
+        eventLoop.modify(conn->fd, EPOLLIN);
+        dispatchRequest(conn);
+    }
+
+    void closeIdleConnections() {
+        auto now = chrono::steady_clock::now();
+        if (now - lastIdleSweep < chrono::seconds(1)) {
+            return;
+        }
+        lastIdleSweep = now;
+        resumeAccepting(); // e.g. after ENOMEM, which no close signals
+
+        vector<Connection*> idle;
+        for (auto& pair : connections) {
+            Connection* conn = pair.second;
+            if (!conn->busy && conn->writeOffset >= conn->writeBuffer.length() &&
+                now - conn->lastActive > chrono::seconds(KEEP_ALIVE_TIMEOUT_SECONDS)) {
+                idle.push_back(conn);
             }
-            
-            string result = controller->adminAddFilm(title, year, runtime, rating, director, cast, tagline, overview, posterPath, backdropPath, genreIds);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path.find("/api/admin/film/") == 0 && req.method == "DELETE") {
-            setAuthFromToken(req.authToken);
-            int filmId = stoi(req.path.substr(16));
-            string result = controller->adminDeleteFilm(filmId);
-            return buildHTTPResponse(200, "OK", result);
-        }
-        else if (req.path.find("/api/admin/user/") == 0 && req.method == "DELETE") {
-            setAuthFromToken(req.authToken);
-            int userId = stoi(req.path.substr(16));
-            string result = controller->adminDeleteUser(userId);
-            return buildHTTPResponse(200, "OK", result);
         }
-        
-        // 404 Not Found
-        return buildHTTPResponse(404, "Not Found", "{\"status\":\"error\",\"message\":\"Endpoint not found\"}");
+        for (Connection* conn : idle) {
+            closeConnection(conn);
+        }
     }
+#endif
 
 public:
-    HTTPServer(int p = 8080) : port(p), running(false), serverSocket(INVALID_SOCKET) {
-        controller = new ServiceController();
+    HTTPServer(int p = 8080) : port(p), serverSocket(INVALID_SOCKET), running(false) {
+        controller = nullptr;
+        workers = new ThreadPool(max(thread::hardware_concurrency(), (unsigned)MIN_WORKER_THREADS));
+        registerRoutes();
+#ifndef _WIN32
+        nextConnectionId = 1;
+        wakeFd = -1;
+        spareFd = -1;
+        acceptPaused = false;
+#endif
     }
 
     ~HTTPServer() {
+        delete workers; // joins in-flight requests before the controller goes away
+#ifndef _WIN32
+        for (auto& pair : connections) {
+            close(pair.first);
+            delete pair.second;
+        }
+        if (wakeFd >= 0) {
+            close(wakeFd);
+        }
+        if (spareFd >= 0) {
+            close(spareFd);
+        }
+#endif
         if (serverSocket != INVALID_SOCKET) {
             closesocket(serverSocket);
         }
+#ifdef _WIN32
         WSACleanup();
+#endif
         delete controller;
     }
 
     bool start() {
+        // Opening the database replays the write-ahead log; refuse to serve if that fails
+        try {
+            controller = new ServiceController();
+        } catch (const WALError& error) {
+            cerr << "Storage error: " << error.what() << endl;
+            return false;
+        }
+
+#ifdef _WIN32
         WSADATA wsaData;
         if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
             cerr << "WSAStartup failed" << endl;
             return false;
         }
+#endif
 
         serverSocket = socket(AF_INET, SOCK_STREAM, 0);
         if (serverSocket == INVALID_SOCKET) {
             cerr << "Socket creation failed" << endl;
-            WSACleanup();
             return false;
         }
 
+#ifndef _WIN32
+        int reuse = 1;
+        setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
         sockaddr_in serverAddr;
         serverAddr.sin_family = AF_INET;
         serverAddr.sin_addr.s_addr = INADDR_ANY;
@@ -384,23 +757,30 @@ public:
 
         if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
             cerr << "Bind failed" << endl;
-            closesocket(serverSocket);
-            WSACleanup();
             return false;
         }
 
         if (listen(serverSocket, SOMAXCONN) == SOCKET_ERROR) {
             cerr << "Listen failed" << endl;
-            closesocket(serverSocket);
-            WSACleanup();
             return false;
         }
 
-        cout << "Server started on port " << port << endl;
+#ifndef _WIN32
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (wakeFd < 0 || !EventLoop::setNonBlocking(serverSocket) || !eventLoop.open() ||
+            !eventLoop.add(serverSocket, EPOLLIN) || !eventLoop.add(wakeFd, EPOLLIN)) {
+            cerr << "epoll setup failed" << endl;
+            return false;
+        }
+#endif
+
+        cout << "Server started on port " << port << " with " << workers->size() << " worker threads" << endl;
         running = true;
         return true;
     }
 
+#ifdef _WIN32
     void run() {
         while (running) {
             SOCKET clientSocket = accept(serverSocket, NULL, NULL);
@@ -408,18 +788,69 @@ public:
                 continue;
             }
 
-            char buffer[4096];
-            int bytesReceived = recv(clientSocket, buffer, 4096, 0);
-            
-            if (bytesReceived > 0) {
-                string rawRequest(buffer, bytesReceived);
-                HTTPRequest req = parseRequest(rawRequest);
-                string response = handleRequest(req);
+            workers->submit([this, clientSocket]() {
+                HTTPParser parser;
+                string rawRequest;
+                char buffer[4096];
+                HTTPParser::State state = HTTPParser::REQUEST_LINE;
                 
-                send(clientSocket, response.c_str(), response.length(), 0);
-            }
+                while (state != HTTPParser::COMPLETE && state != HTTPParser::ERROR) {
+                    int bytesReceived = recv(clientSocket, buffer, sizeof(buffer), 0);
+                    if (bytesReceived <= 0) break;
+                    rawRequest.append(buffer, bytesReceived);
+                    state = parser.parse(rawRequest.data(), rawRequest.length());
+                }
+                
+                string response;
+                if (state == HTTPParser::COMPLETE) {
+                    HTTPRequest req = parser.request();
+                    req.keepAlive = false; // blocking loop serves one request per connection
+                    response = handleRequestSafely(req);
+                } else if (state == HTTPParser::ERROR) {
+                    response = buildErrorResponse(parser.getErrorStatus());
+                }
+                
+                if (!response.empty()) {
+                    send(clientSocket, response.c_str(), response.length(), 0);
+                }
+
+                closesocket(clientSocket);
+            });
+        }
+    }
+#else
+    void run() {
+        while (running) {
+            int ready = eventLoop.wait(1000);
+            for (int i = 0; i < ready; i++) {
+                int fd = eventLoop.readyFd(i);
+                uint32_t events = eventLoop.readyEvents(i);
 
-            closesocket(clientSocket);
+                if (fd == serverSocket) {
+                    acceptConnections();
+                    continue;
+                }
+                if (fd == wakeFd) {
+                    drainCompletions();
+                    continue;
+                }
+
+                auto it = connections.find(fd);
+                if (it == connections.end()) continue;
+                Connection* conn = it->second;
+
+                if (events & (EPOLLERR | EPOLLHUP)) {
+                    closeConnection(conn);
+                } else if (conn->busy) {
+                    continue;
+                } else if (events & EPOLLIN) {
+                    onReadable(conn);
+                } else if (events & EPOLLOUT) {
+                    onWritable(conn);
+                }
+            }
+            closeIdleConnections();
         }
     }
+#endif
 };
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+
+using namespace std;
+
+#define MAX_ROUTE_PARAMS 4
+#define MAX_QUERY_PARAMS 8
+
+enum HTTPMethod {
+    METHOD_GET,
+    METHOD_POST,
+    METHOD_DELETE,
+    METHOD_COUNT,
+    METHOD_UNKNOWN = METHOD_COUNT
+};
+
+inline HTTPMethod parseMethod(string_view method) {
+    if (method == "GET") return METHOD_GET;
+    if (method == "POST") return METHOD_POST;
+    if (method == "DELETE") return METHOD_DELETE;
+    return METHOD_UNKNOWN;
+}
+
+// Path parameters captured during a match. Values are views into the request path.
+struct RouteParams {
+    struct Param {
+        string_view name;
+        string_view value;
+        int intValue;
+    };
+
+    Param params[MAX_ROUTE_PARAMS];
+    int count;
+
+    RouteParams() : count(0) {}
+
+    int getInt(string_view name) const {
+        for (int i = 0; i < count; i++) {
+            if (params[i].name == name) return params[i].intValue;
+        }
+        return 0;
+    }
+
+    string_view get(string_view name) const {
+        for (int i = 0; i < count; i++) {
+            if (params[i].name == name) return params[i].value;
+        }
+        return string_view();
+    }
+};
+
+// key=value pairs from the query string, still percent-encoded
+struct QueryParams {
+    struct Pair {
+        string_view key;
+        string_view value;
+    };
+
+    Pair pairs[MAX_QUERY_PARAMS];
+    int count;
+
+    QueryParams() : count(0) {}
+
+    void parse(string_view query) {
+        count = 0;
+        while (!query.empty() && count < MAX_QUERY_PARAMS) {
+            size_t amp = query.find('&');
+            string_view pair = query.substr(0, amp);
+            size_t eq = pair.find('=');
+            if (!pair.empty()) {
+                pairs[count].key = pair.substr(0, eq);
+                pairs[count].value = (eq == string_view::npos) ? string_view() : pair.substr(eq + 1);
+                count++;
+            }
+            if (amp == string_view::npos) break;
+            query.remove_prefix(amp + 1);
+        }
+    }
+
+    bool has(string_view key) const {
+        for (int i = 0; i < count; i++) {
+            if (pairs[i].key == key) return true;
+        }
+        return false;
+    }
+
+    string_view get(string_view key) const {
+        for (int i = 0; i < count; i++) {
+            if (pairs[i].key == key) return pairs[i].value;
+        }
+        return string_view();
+    }
+
+    // Optional sign and digits; fallback if absent, malformed or out of int range
+    int getInt(string_view key, int fallback) const {
+        string_view value = get(key);
+        bool negative = !value.empty() && value.front() == '-';
+        if (negative) value.remove_prefix(1);
+        if (value.empty() || value.length() > 10) return fallback;
+        long long result = 0;
+        for (char c : value) {
+            if (c < '0' || c > '9') return fallback;
+            result = result * 10 + (c - '0');
+        }
+        if (negative) result = -result;
+        if (result < INT_MIN || result > INT_MAX) return fallback;
+        return (int)result;
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        return (tolower((unsigned char)c) - 'a') + 10;
+    }
+
+    // Decodes %XX escapes and '+' as space
+    static string decode(string_view value) {
+        string result;
+        result.reserve(value.length());
+        for (size_t i = 0; i < value.length(); i++) {
+            char c = value[i];
+            if (c == '+') {
+                result += ' ';
+            } else if (c == '%' && i + 2 < value.length() && isxdigit((unsigned char)value[i + 1]) &&
+                       isxdigit((unsigned char)value[i + 2])) {
+                result += (char)(hexValue(value[i + 1]) * 16 + hexValue(value[i + 2]));
+                i += 2;
+            } else {
+                result += c;
+            }
+        }
+        return result;
+    }
+};
+
+template<typename Handler>
+struct RouteMatch {
+    Handler handler;
+    RouteParams params;
+    QueryParams query;
+};
+
+// Segment trie over route patterns such as "/api/user/{userId:int}/logs".
+// Built once at startup; match() walks the path one segment at a time
+// without allocating. Static segments take priority over parameters.
+template<typename Handler>
+class Router {
+private:
+    enum ParamType {
+        PARAM_STRING,
+        PARAM_INT
+    };
+
+    struct RouteNode {
+        vector<pair<string, RouteNode*>> children; // static segments, sorted by name
+        RouteNode* paramChild;
+        string paramName;
+        ParamType paramType;
+        Handler handlers[METHOD_COUNT];
+        bool hasHandler[METHOD_COUNT];
+
+        RouteNode() : paramChild(nullptr), paramType(PARAM_STRING) {
+            for (int i = 0; i < METHOD_COUNT; i++) {
+                hasHandler[i] = false;
+            }
+        }
+
+        ~RouteNode() {
+            for (auto& child : children) {
+                delete child.second;
+            }
+            delete paramChild;
+        }
+
+        bool hasAnyHandler() const {
+            for (int i = 0; i < METHOD_COUNT; i++) {
+                if (hasHandler[i]) return true;
+            }
+            return false;
+        }
+
+        RouteNode* findChild(string_view segment) const {
+            auto it = lower_bound(children.begin(), children.end(), segment,
+                                  [](const pair<string, RouteNode*>& child, string_view s) {
+                                      return string_view(child.first) < s;
+                                  });
+            if (it != children.end() && it->first == segment) return it->second;
+            return nullptr;
+        }
+    };
+
+    RouteNode* root;
+
+    static string_view nextSegment(string_view& path) {
+        while (!path.empty() && path.front() == '/') path.remove_prefix(1);
+        size_t slash = path.find('/');
+        string_view segment = path.substr(0, slash);
+        path.remove_prefix(slash == string_view::npos ? path.length() : slash);
+        return segment;
+    }
+
+    static bool parseInt(string_view segment, int& value) {
+        if (segment.empty() || segment.length() > 9) return false;
+        value = 0;
+        for (char c : segment) {
+            if (c < '0' || c > '9') return false;
+            value = value * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    // Returns the node for the remaining path, or nullptr; params are filled along the way
+    RouteNode* matchNode(RouteNode* node, string_view path, RouteParams& params) const {
+        string_view segment = nextSegment(path);
+        if (segment.empty()) {
+            return node;
+        }
+
+        if (RouteNode* child = node->findChild(segment)) {
+            if (RouteNode* found = matchNode(child, path, params)) return found;
+        }
+
+        RouteNode* paramNode = node->paramChild;
+        if (paramNode && params.count < MAX_ROUTE_PARAMS) {
+            RouteParams::Param& param = params.params[params.count];
+            param.intValue = 0;
+            if (node->paramType == PARAM_INT && !parseInt(segment, param.intValue)) {
+                return nullptr;
+            }
+            param.name = node->paramName;
+            param.value = segment;
+            params.count++;
+            if (RouteNode* found = matchNode(paramNode, path, params)) return found;
+            params.count--;
+        }
+        return nullptr;
+    }
+
+public:
+    enum MatchResult {
+        MATCHED,
+        NOT_FOUND,
+        METHOD_NOT_ALLOWED
+    };
+
+    Router() {
+        root = new RouteNode();
+    }
+
+    ~Router() {
+        delete root;
+    }
+
+    // pattern segments: "literal", "{name}" or "{name:int}"
+    void add(HTTPMethod method, const string& pattern, Handler handler) {
+        RouteNode* node = root;
+        string_view rest(pattern);
+        while (true) {
+            string_view segment = nextSegment(rest);
+            if (segment.empty()) break;
+
+            if (segment.front() == '{' && segment.back() == '}') {
+                string_view spec = segment.substr(1, segment.length() - 2);
+                size_t colon = spec.find(':');
+                if (!node->paramChild) {
+                    node->paramChild = new RouteNode();
+                    node->paramName = string(spec.substr(0, colon));
+                    node->paramType = (colon != string_view::npos && spec.substr(colon + 1) == "int")
+                                          ? PARAM_INT : PARAM_STRING;
+                }
+                node = node->paramChild;
+            } else {
+                RouteNode* child = node->findChild(segment);
+                if (!child) {
+                    child = new RouteNode();
+                    node->children.emplace_back(string(segment), child);
+                    sort(node->children.begin(), node->children.end(),
+                         [](const pair<string, RouteNode*>& a, const pair<string, RouteNode*>& b) {
+                             return a.first < b.first;
+                         });
+                }
+                node = child;
+            }
+        }
+        node->handlers[method] = handler;
+        node->hasHandler[method] = true;
+    }
+
+    MatchResult match(string_view method, string_view target, RouteMatch<Handler>& result) const {
+        size_t queryStart = target.find('?');
+        string_view path = target.substr(0, queryStart);
+        result.query.parse(queryStart == string_view::npos ? string_view() : target.substr(queryStart + 1));
+        result.params.count = 0;
+
+        RouteNode* node = matchNode(root, path, result.params);
+        if (!node || !node->hasAnyHandler()) return NOT_FOUND;
+
+        HTTPMethod m = parseMethod(method);
+        if (m == METHOD_UNKNOWN || !node->hasHandler[m]) return METHOD_NOT_ALLOWED;
+
+        result.handler = node->handlers[m];
+        return MATCHED;
+    }
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <unordered_map>
+#include <mutex>
+
+using namespace std;
+
+// Ready-serialised JSON pieces per entity id, built on first use. Readers
+// holding the database lock shared may fill it concurrently; entries are
+// only removed by writers holding it exclusively, so a pointer from get()
+// stays valid for as long as the caller holds the lock.
+template<typename Fragments>
+class FragmentCache {
+private:
+    unordered_map<int, Fragments> entries;
+    mutex entriesMutex;
+
+public:
+    // build(fragments) fills in the pieces for id and returns false if the
+    // entity does not exist, in which case nothing is cached
+    template<typename Build>
+    const Fragments* get(int id, Build build) {
+        {
+            lock_guard<mutex> lock(entriesMutex);
+            auto it = entries.find(id);
+            if (it != entries.end()) return &it->second;
+        }
+        Fragments fragments;
+        if (!build(fragments)) return nullptr;
+        lock_guard<mutex> lock(entriesMutex);
+        return &entries.emplace(id, move(fragments)).first->second;
+    }
+
+    // For writers, on update or delete of the entity
+    void invalidate(int id) {
+        lock_guard<mutex> lock(entriesMutex);
+        entries.erase(id);
+    }
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+// Identity of the caller for a single request, parsed from the Authorization token.
+// Passed into every ServiceController call so concurrent requests never share auth state.
+struct RequestContext {
+    int userId;
+    bool isLoggedIn;
+    bool isAdmin;
+
+    RequestContext() : userId(0), isLoggedIn(false), isAdmin(false) {}
+
+    RequestContext(int uid, bool loggedIn, bool admin)
+        : userId(uid), isLoggedIn(loggedIn), isAdmin(admin) {}
+};
@@ -1,7 +1,13 @@
 #pragma once
 
+#include "../ds/WriteAheadLog.h"
+#include "../ds/BufferPool.h"
 #include "../ds/BTree.h"
+#include "../ds/BPlusTree.h"
+#include "../ds/SecondaryIndex.h"
+#include "../ds/HashIndex.h"
 #include "../ds/Trie.h"
+#include "../ds/InvertedIndex.h"
 #include "../ds/SocialGraph.h"
 #include "../models/User.h"
 #include "../models/Film.h"
@@ -10,26 +16,86 @@
 #include "../models/List.h"
 #include "../models/Interaction.h"
 #include "../utils/JSONLoader.h"
+#include "RequestContext.h"
+#include "SuggestionEngine.h"
+#include "SubstringSearch.h"
+#include "FragmentCache.h"
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <fstream>
+#include <shared_mutex>
+#include <mutex>
 
 using namespace std;
 
+// Shared page cache for every tree; the whole data set fits comfortably
+#ifndef BUFFER_POOL_SIZE
+#define BUFFER_POOL_SIZE (32 * 1024 * 1024)
+#endif
+
+// Best-rated films kept per title trie node; the most a film search returns
+#define SEARCH_TOP_K 20
+// Time a fuzzy search may spend walking the title word trie
+#define FUZZY_BUDGET_US 10000
+// Occurrences a substring search looks at, and what its entries are
+#define SUBSTRING_SCAN_LIMIT 4096
+#define SUBSTRING_FILM 0
+#define SUBSTRING_USER 1
+
+// A response body serialised once per catalogue version, with its strong
+// ETag (a hash of the body, so it also holds across restarts)
+struct CachedResponse {
+    uint64_t version;
+    string body;
+    string etag;
+};
+
+// Pre-serialised pieces of a film's JSON. Objects are left open so
+// endpoints can append their own fields before the closing brace.
+struct FilmJson {
+    string full;    // every Film field, through genre_ids
+    string card;    // film_id, title, year, director, poster_path
+    string rating;  // vote_average, one decimal
+};
+
+struct UserJson {
+    string card;      // user_id, username, avatar_id (open)
+    string bioField;  // ,"bio":"..."
+    bool isAdmin;
+};
+
 class ServiceController {
 private:
-    BTree<User>* userTree;
-    BTree<Film>* filmTree;
-    BTree<Log>* logTree;
+    WriteAheadLog* wal;
+    BufferPool* bufferPool;
+    IndexedBTree<User>* userTree;
+    BPlusTree<Film>* filmTree;
+    IndexedBTree<Log>* logTree;
     BTree<Genre>* genreTree;
     BTree<List>* listTree;
-    BTree<Interaction>* interactionTree;
+    IndexedBTree<Interaction>* interactionTree;
+    SecondaryIndex<Log, 2>* logsByUser; // (user_id, watch_date)
+    SecondaryIndex<Log>* logsByFilm;
+    SecondaryIndex<Log>* logsByDate;
+    SecondaryIndex<Interaction, 3>* interactionsByKey; // unique (user_id, type, film_id)
+    HashIndex<User, 32>* usersByName; // unique, case-insensitive
+    HashIndex<User, 64>* usersByEmail; // unique, case-insensitive
     Trie* searchTrie;
+    Trie* titleWordTrie; // each title from every word start, for fuzzy search
+    InvertedIndex* filmText; // director, cast and tagline
+    SubstringSearch* substrings; // film titles and usernames
     Trie* userTrie;
     SocialGraph* socialGraph;
+    SuggestionEngine* suggestionEngine;
+    uint64_t catalogueVersion; // bumped by every film mutation, for cached responses
+    shared_ptr<const CachedResponse> filmsResponse;
+    shared_ptr<const CachedResponse> genresResponse;
+    mutex responseCacheMutex;
+    FragmentCache<FilmJson> filmFragments;
+    FragmentCache<UserJson> userFragments;
     
     int nextUserId;
     int nextFilmId;
@@ -38,36 +104,332 @@ private:
     int nextListId;
     int nextInteractionId;
 
-    int currentUserId;
-    bool isLoggedIn;
-    bool currentUserIsAdmin;
+    // Readers share the trees; any mutation takes the lock exclusively
+    shared_mutex dbMutex;
+
+    // Exclusive access for one mutation. The lock is dropped before waiting
+    // for the WAL, so writers queued behind this one share the next fsync;
+    // the response is only returned once the change is durable.
+    class WriteGuard {
+    private:
+        ServiceController& owner;
+        unique_lock<shared_mutex> lock;
+        uint64_t journalStart;
+
+    public:
+        WriteGuard(ServiceController& controller) : owner(controller), lock(controller.dbMutex) {
+            owner.wal->begin();
+            journalStart = owner.socialGraph->journalSequence();
+        }
+
+        // Everything the mutation logged, across all trees, commits as one
+        // record; follows and unfollows wait for the social journal the same
+        // way. If either cannot be made durable the request fails with
+        // WALError instead of returning its response.
+        ~WriteGuard() noexcept(false) {
+            uint64_t lsn = owner.wal->commit();
+            uint64_t journal = owner.socialGraph->journalSequence();
+            lock.unlock();
+            bool durable = owner.wal->waitDurable(lsn);
+            if (durable && journal > journalStart) {
+                durable = owner.socialGraph->waitJournal(journal);
+            }
+            if (!durable) {
+                if (uncaught_exceptions() == 0) throw WALError("commit could not be made durable");
+                return;
+            }
+
+            if (owner.wal->needsCheckpoint()) {
+                unique_lock<shared_mutex> relock(owner.dbMutex);
+                if (owner.wal->needsCheckpoint()) {
+                    owner.checkpointTrees();
+                }
+            }
+        }
+    };
+
+    // Writes every logged page back to the .bin files and empties the log.
+    // The log is kept unless every tree wrote and synced cleanly, so a later
+    // checkpoint or the next start's replay can redo it.
+    // Caller holds dbMutex exclusively (or is the constructor/destructor).
+    bool checkpointTrees() {
+        if (!wal->flush()) return false;
+        bool written = userTree->checkpoint();
+        written = filmTree->checkpoint() && written;
+        written = logTree->checkpoint() && written;
+        written = genreTree->checkpoint() && written;
+        written = listTree->checkpoint() && written;
+        written = interactionTree->checkpoint() && written;
+        if (!written) {
+            cerr << "Checkpoint failed; keeping the write-ahead log" << endl;
+            return false;
+        }
+        return wal->truncate();
+    }
+
+    // FNV-1a of the body, quoted
+    static string etagFor(const string& body) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : body) {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        ostringstream etag;
+        etag << "\"" << hex << setw(16) << setfill('0') << hash << "\"";
+        return etag.str();
+    }
+
+    // The slot's response if it is from the current catalogue version, else
+    // a fresh one from serialize(). Callers hold dbMutex shared.
+    template<typename Serialize>
+    shared_ptr<const CachedResponse> cachedResponse(shared_ptr<const CachedResponse>& slot, Serialize serialize) {
+        {
+            lock_guard<mutex> lock(responseCacheMutex);
+            if (slot && slot->version == catalogueVersion) return slot;
+        }
+        auto fresh = make_shared<CachedResponse>();
+        fresh->version = catalogueVersion;
+        fresh->body = serialize();
+        fresh->etag = etagFor(fresh->body);
+        lock_guard<mutex> lock(responseCacheMutex);
+        slot = fresh;
+        return slot;
+    }
 
-    string escapeJson(const string& input) {
-        ostringstream output;
-        for (char c : input) {
+    // Appends text as the inside of a JSON string, copying runs that need
+    // no escaping in one go
+    static void appendEscaped(string& out, const char* text, size_t length) {
+        static const char hexDigits[] = "0123456789abcdef";
+        size_t run = 0;
+        for (size_t i = 0; i < length; i++) {
+            unsigned char c = text[i];
+            if (c != '"' && c != '\\' && c >= 0x20) continue;
+            out.append(text + run, i - run);
+            run = i + 1;
             switch (c) {
-                case '"': output << "\\\""; break;
-                case '\\': output << "\\\\"; break;
-                case '\n': output << "\\n"; break;
-                case '\r': output << "\\r"; break;
-                case '\t': output << "\\t"; break;
-                default: output << c; break;
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    out += "\\u00";
+                    out += hexDigits[c >> 4];
+                    out += hexDigits[c & 0xF];
+                    break;
             }
         }
-        return output.str();
+        out.append(text + run, length - run);
+    }
+
+    static void appendEscaped(string& out, const char* text) {
+        appendEscaped(out, text, strlen(text));
+    }
+
+    static string escapeJson(const string& input) {
+        string output;
+        output.reserve(input.size());
+        appendEscaped(output, input.data(), input.size());
+        return output;
+    }
+
+    static void buildFilmJson(const Film& film, FilmJson& json) {
+        json.card = "{\"film_id\":" + to_string(film.film_id) + ",\"title\":\"";
+        appendEscaped(json.card, film.title);
+        json.card += "\",\"year\":" + to_string(film.release_year) + ",\"director\":\"";
+        appendEscaped(json.card, film.director);
+        json.card += "\",\"poster_path\":\"";
+        appendEscaped(json.card, film.poster_path);
+        json.card += "\"";
+
+        ostringstream rating;
+        rating << fixed << setprecision(1) << film.vote_average;
+        json.rating = rating.str();
+
+        string& full = json.full;
+        full = "{\"film_id\":" + to_string(film.film_id) + ",\"tmdb_id\":" + to_string(film.tmdb_id) + ",\"title\":\"";
+        appendEscaped(full, film.title);
+        full += "\",\"year\":" + to_string(film.release_year) + ",\"runtime\":" + to_string(film.runtime) +
+                ",\"cast_summary\":\"";
+        appendEscaped(full, film.cast_summary);
+        full += "\",\"director\":\"";
+        appendEscaped(full, film.director);
+        full += "\",\"poster_path\":\"";
+        appendEscaped(full, film.poster_path);
+        full += "\",\"backdrop_path\":\"";
+        appendEscaped(full, film.backdrop_path);
+        full += "\",\"tagline\":\"";
+        appendEscaped(full, film.tagline);
+        full += "\",\"vote_average\":" + json.rating + ",\"genre_ids\":[" + to_string(film.genre_ids[0]) + "," +
+                to_string(film.genre_ids[1]) + "," + to_string(film.genre_ids[2]) + "]";
+    }
+
+    // Fragments of a film that exists, from the cache or the tree. Callers
+    // hold dbMutex.
+    const FilmJson* filmJson(int filmId) {
+        return filmFragments.get(filmId, [&](FilmJson& json) {
+            Film film;
+            if (!filmTree->search(filmId, film)) return false;
+            buildFilmJson(film, json);
+            return true;
+        });
+    }
+
+    // Same, for a film already read
+    const FilmJson* filmJson(const Film& film) {
+        return filmFragments.get(film.film_id, [&](FilmJson& json) {
+            buildFilmJson(film, json);
+            return true;
+        });
+    }
+
+    const UserJson* userJson(int userId) {
+        return userFragments.get(userId, [&](UserJson& json) {
+            User user;
+            if (!userTree->search(userId, user)) return false;
+            json.card = "{\"user_id\":" + to_string(user.user_id) + ",\"username\":\"";
+            appendEscaped(json.card, user.username);
+            json.card += "\",\"avatar_id\":" + to_string(user.avatar_id);
+            json.bioField = ",\"bio\":\"";
+            appendEscaped(json.bioField, user.bio);
+            json.bioField += "\"";
+            json.isAdmin = user.isAdmin;
+            return true;
+        });
+    }
+
+    // Films live in a B+tree (films.bpt). The first start after the switch
+    // imports them from the old B-tree file, which is left in place.
+    void openFilmTree() {
+        if (!ifstream("data/films.bpt").good() && ifstream("data/films.bin").good()) {
+            importLegacyFilms();
+        }
+        filmTree = new BPlusTree<Film>("data/films.bpt", bufferPool, wal);
+    }
+
+    // Copies films.bin into a B+tree built beside the live name, outside the
+    // log, and renames it into place only once it is synced. A crash midway
+    // leaves no films.bpt, so the next start redoes the import.
+    void importLegacyFilms() {
+        const string staging = "data/films.bpt.tmp";
+        remove(staging.c_str());
+
+        BTree<Film> legacy("data/films.bin");
+        vector<Film> films = legacy.getAllRecords();
+        sort(films.begin(), films.end(), [](const Film& a, const Film& b) {
+            return a.film_id < b.film_id;
+        });
+
+        BufferPool stagingPool(BUFFER_POOL_SIZE);
+        BPlusTree<Film>* tree = new BPlusTree<Film>(staging, &stagingPool);
+        for (const auto& film : films) {
+            tree->insert(film);
+        }
+        bool written = tree->checkpoint();
+        delete tree;
+        if (!written || rename(staging.c_str(), "data/films.bpt") != 0) {
+            remove(staging.c_str());
+            throw WALError("could not import data/films.bin");
+        }
+        cout << "Imported " << films.size() << " films from data/films.bin" << endl;
+    }
+
+    // Distinct films the user has logged, sorted; called from suggestion workers
+    void loggedFilms(int userId, vector<int>& films) {
+        films.clear();
+        logTree->forEachWhere(logsByUser, {userId}, [&](const Log& log) {
+            films.push_back(log.film_id);
+            return true;
+        });
+        sort(films.begin(), films.end());
+        films.erase(unique(films.begin(), films.end()), films.end());
+    }
+
+    // Films the user liked (type 1) or watchlisted (type 2), oldest first.
+    // Read from the index entries alone; the table is not touched.
+    vector<int> interactionFilms(int userId, int type) {
+        vector<pair<int, int>> entries; // (interaction_id, film_id)
+        interactionsByKey->forEachEntry({userId, type}, [&](const IndexKey<3>& entry) {
+            entries.emplace_back(entry.id, entry.parts[2]);
+            return true;
+        });
+        sort(entries.begin(), entries.end());
+
+        vector<int> filmIds;
+        filmIds.reserve(entries.size());
+        for (const auto& entry : entries) {
+            filmIds.push_back(entry.second);
+        }
+        return filmIds;
+    }
+
+    // Activity feed entries for the newest logs with watch_date in [from, to).
+    // Walks the date index backwards, so only about `limit` logs are read.
+    void writeRecentLogs(ostringstream& json, int limit, int from = INT32_MIN, int to = INT32_MAX) {
+        int count = 0;
+        if (limit <= 0) return;
+        logTree->forEachInRange(logsByDate, {}, from, to, true, [&](const Log& log) {
+            User user;
+            Film film;
+            if (userTree->search(log.user_id, user) && filmTree->search(log.film_id, film)) {
+                if (count > 0) json << ",";
+                json << "{\"username\":\"" << escapeJson(user.username) << "\""
+                     << ",\"film_title\":\"" << escapeJson(film.title) << "\""
+                     << ",\"rating\":" << fixed << setprecision(1) << log.rating
+                     << ",\"date\":" << log.watch_date << "}";
+                count++;
+            }
+            return count < limit;
+        });
+    }
+
+    static time_t startOfYear(int year) {
+        struct tm start = {};
+        start.tm_year = year - 1900;
+        start.tm_mday = 1;
+        start.tm_isdst = -1;
+        return mktime(&start);
+    }
+
+    static struct tm toLocalTime(time_t t) {
+        struct tm result;
+#ifdef _WIN32
+        localtime_s(&result, &t);
+#else
+        localtime_r(&t, &result);
+#endif
+        return result;
     }
 
 public:
-    ServiceController() : currentUserId(0), isLoggedIn(false), currentUserIsAdmin(false) {
-        userTree = new BTree<User>("data/users.bin");
-        filmTree = new BTree<Film>("data/films.bin");
-        logTree = new BTree<Log>("data/logs.bin");
-        genreTree = new BTree<Genre>("data/genres.bin");
-        listTree = new BTree<List>("data/lists.bin");
-        interactionTree = new BTree<Interaction>("data/interactions.bin");
-        searchTrie = new Trie();
+    ServiceController() {
+        // Replays anything a crash left behind before the trees open their files
+        wal = new WriteAheadLog("data/wal.log");
+        bufferPool = new BufferPool(BUFFER_POOL_SIZE, wal);
+        // Read-mostly trees are mapped; the write-heavy ones go through the pool
+        userTree = new IndexedBTree<User>("data/users.bin", bufferPool, STORAGE_MMAP, wal);
+        usersByName = userTree->attachIndex(
+            new HashIndex<User, 32>("data/users_by_name.hix", &User::username, true, userTree, bufferPool, wal),
+            "data/users_by_name.hix");
+        usersByEmail = userTree->attachIndex(
+            new HashIndex<User, 64>("data/users_by_email.hix", &User::email, true, userTree, bufferPool, wal),
+            "data/users_by_email.hix");
+        openFilmTree();
+        logTree = new IndexedBTree<Log>("data/logs.bin", bufferPool, STORAGE_BUFFERED, wal);
+        logsByUser = logTree->addIndex("data/logs_by_user_date.idx", {&Log::user_id, &Log::watch_date});
+        logsByFilm = logTree->addIndex("data/logs_by_film.idx", {&Log::film_id});
+        logsByDate = logTree->addIndex("data/logs_by_date.idx", {&Log::watch_date});
+        genreTree = new BTree<Genre>("data/genres.bin", bufferPool, STORAGE_MMAP, wal);
+        listTree = new BTree<List>("data/lists.bin", bufferPool, STORAGE_BUFFERED, wal);
+        interactionTree = new IndexedBTree<Interaction>("data/interactions.bin", bufferPool, STORAGE_BUFFERED, wal);
+        interactionsByKey = interactionTree->addIndex(
+            "data/interactions_by_key.idx", {&Interaction::user_id, &Interaction::type, &Interaction::film_id}, true);
+        searchTrie = new Trie(SEARCH_TOP_K);
+        titleWordTrie = new Trie(SEARCH_TOP_K);
+        filmText = new InvertedIndex();
         userTrie = new Trie();
         socialGraph = new SocialGraph("data/social.bin");
+        suggestionEngine = new SuggestionEngine(socialGraph);
+        catalogueVersion = 0;
         
         nextUserId = userTree->getMaxId() + 1;
         nextFilmId = filmTree->getMaxId() + 1;
@@ -77,11 +439,15 @@ public:
         nextInteractionId = interactionTree->getMaxId() + 1;
 
         loadInitialData();
+        checkpointTrees();
         buildSearchIndex();
         buildUserIndex();
+        substrings = new SubstringSearch([this] { return substringEntries(); });
     }
 
     ~ServiceController() {
+        delete substrings;
+        checkpointTrees();
         delete userTree;
         delete filmTree;
         delete logTree;
@@ -89,54 +455,55 @@ public:
         delete listTree;
         delete interactionTree;
         delete searchTrie;
+        delete titleWordTrie;
+        delete filmText;
         delete userTrie;
+        delete suggestionEngine;
         delete socialGraph;
-    }
-    
-    void setCurrentUser(int userId, bool loggedIn, bool isAdmin) {
-        currentUserId = userId;
-        isLoggedIn = loggedIn;
-        currentUserIsAdmin = isAdmin;
+        delete bufferPool;
+        delete wal;
     }
 
     // Authentication
-    string loginUser(const string& username, const string& password) {
-        vector<User> allUsers = userTree->getAllRecords();
-        
-        for (const auto& user : allUsers) {
-            if (string(user.username) == username && string(user.password_hash) == password) {
-                currentUserId = user.user_id;
-                isLoggedIn = true;
-                currentUserIsAdmin = user.isAdmin;
-                
-                ostringstream token;
-                token << user.user_id << ":" << user.username << ":" << (user.isAdmin ? "1" : "0");
-                
-                ostringstream json;
-                json << "{\"status\":\"success\",\"token\":\"" << token.str() << "\""
-                     << ",\"isAdmin\":" << (user.isAdmin ? "true" : "false") << "}";
-                return json.str();
-            }
-        }
-        
-        return "{\"status\":\"error\",\"message\":\"Invalid credentials\"}";
+    string loginUser(const RequestContext& ctx, const string& username, const string& password) {
+        shared_lock<shared_mutex> lock(dbMutex);
+        // One hash probe; usernames match ignoring case
+        string result = "{\"status\":\"error\",\"message\":\"Invalid credentials\"}";
+        usersByName->forEachMatch(username.c_str(), [&](const User& user) {
+            if (string(user.password_hash) != password) return true;
+            ostringstream token;
+            token << user.user_id << ":" << user.username << ":" << (user.isAdmin ? "1" : "0");
+            
+            ostringstream json;
+            json << "{\"status\":\"success\",\"token\":\"" << token.str() << "\""
+                 << ",\"isAdmin\":" << (user.isAdmin ? "true" : "false") << "}";
+            result = json.str();
+            return false;
+        });
+        return result;
     }
 
-    string registerUser(const string& username, const string& email, const string& password, const string& bio) {
-        vector<User> allUsers = userTree->getAllRecords();
-        
-        for (const auto& user : allUsers) {
-            if (string(user.username) == username) {
-                return "{\"status\":\"error\",\"message\":\"Username already exists\"}";
-            }
+    string registerUser(const RequestContext& ctx, const string& username, const string& email, const string& password, const string& bio) {
+        WriteGuard guard(*this);
+        if (usersByName->contains(username.c_str())) {
+            return "{\"status\":\"error\",\"message\":\"Username already exists\"}";
+        }
+        if (usersByEmail->contains(email.c_str())) {
+            return "{\"status\":\"error\",\"message\":\"Email already registered\"}";
         }
         
-        User newUser(nextUserId++, username.c_str(), email.c_str(), password.c_str(), bio.c_str(), false);
-        userTree->insert(newUser);
+        // The indexes also refuse names that only collide once truncated to the field
+        User newUser(nextUserId, username.c_str(), email.c_str(), password.c_str(), bio.c_str(), false);
+        if (!userTree->insert(newUser)) {
+            return "{\"status\":\"error\",\"message\":\"Username or email already exists\"}";
+        }
+        nextUserId++;
+        userFragments.invalidate(newUser.user_id);
         
         // Add to user search index (non-admin users only)
         if (!newUser.isAdmin) {
             userTrie->insert(newUser.username, newUser.user_id);
+            substrings->requestRebuild();
         }
         
         // Auto-login the new user
@@ -150,7 +517,13 @@ public:
     }
 
     // Films
-    string getAllFilms() {
+    // Serialised once per catalogue version; films are the same for everyone
+    shared_ptr<const CachedResponse> getAllFilms(const RequestContext& ctx) {
+        shared_lock<shared_mutex> lock(dbMutex);
+        return cachedResponse(filmsResponse, [this] { return serializeFilms(); });
+    }
+
+    string serializeFilms() {
         vector<Film> films = filmTree->getAllRecords();
         
         ostringstream json;
@@ -158,64 +531,34 @@ public:
         
         for (size_t i = 0; i < films.size(); i++) {
             if (i > 0) json << ",";
-            json << "{\"film_id\":" << films[i].film_id
-                 << ",\"tmdb_id\":" << films[i].tmdb_id
-                 << ",\"title\":\"" << escapeJson(films[i].title) << "\""
-                 << ",\"year\":" << films[i].release_year
-                 << ",\"runtime\":" << films[i].runtime
-                 << ",\"cast_summary\":\"" << escapeJson(films[i].cast_summary) << "\""
-                 << ",\"director\":\"" << escapeJson(films[i].director) << "\""
-                 << ",\"poster_path\":\"" << escapeJson(films[i].poster_path) << "\""
-                 << ",\"backdrop_path\":\"" << escapeJson(films[i].backdrop_path) << "\""
-                 << ",\"tagline\":\"" << escapeJson(films[i].tagline) << "\""
-                 << ",\"vote_average\":" << fixed << setprecision(1) << films[i].vote_average
-                 << ",\"genre_ids\":[" << films[i].genre_ids[0] << "," 
-                 << films[i].genre_ids[1] << "," << films[i].genre_ids[2] << "]}";
+            json << filmJson(films[i])->full << "}";
         }
         
         json << "]}";
         return json.str();
     }
 
-    string getFilmById(int filmId) {
+    string getFilmById(const RequestContext& ctx, int filmId) {
+        shared_lock<shared_mutex> lock(dbMutex);
         Film film;
         if (filmTree->search(filmId, film)) {
             // Check interactions
             bool watched = false, liked = false, watchlisted = false;
             
-            if (isLoggedIn) {
-                vector<Log> logs = logTree->getAllRecords();
-                for (const auto& log : logs) {
-                    if (log.user_id == currentUserId && log.film_id == filmId) {
-                        watched = true;
-                        break;
-                    }
-                }
-                
-                vector<Interaction> interactions = interactionTree->getAllRecords();
-                for (const auto& inter : interactions) {
-                    if (inter.user_id == currentUserId && inter.film_id == filmId) {
-                        if (inter.type == 1) liked = true;
-                        if (inter.type == 2) watchlisted = true;
-                    }
-                }
+            if (ctx.isLoggedIn) {
+                int userId = ctx.userId;
+                logTree->forEachWhere(logsByFilm, {filmId}, [&](const Log& log) {
+                    watched = log.user_id == userId;
+                    return !watched;
+                });
+
+                int interactionId;
+                liked = interactionsByKey->findId({userId, 1, filmId}, interactionId);
+                watchlisted = interactionsByKey->findId({userId, 2, filmId}, interactionId);
             }
             
             ostringstream json;
-            json << "{\"status\":\"success\",\"film\":{"
-                 << "\"film_id\":" << film.film_id
-                 << ",\"tmdb_id\":" << film.tmdb_id
-                 << ",\"title\":\"" << escapeJson(film.title) << "\""
-                 << ",\"year\":" << film.release_year
-                 << ",\"runtime\":" << film.runtime
-                 << ",\"cast_summary\":\"" << escapeJson(film.cast_summary) << "\""
-                 << ",\"director\":\"" << escapeJson(film.director) << "\""
-                 << ",\"poster_path\":\"" << escapeJson(film.poster_path) << "\""
-                 << ",\"backdrop_path\":\"" << escapeJson(film.backdrop_path) << "\""
-                 << ",\"tagline\":\"" << escapeJson(film.tagline) << "\""
-                 << ",\"vote_average\":" << fixed << setprecision(1) << film.vote_average
-                 << ",\"genre_ids\":[" << film.genre_ids[0] << "," 
-                 << film.genre_ids[1] << "," << film.genre_ids[2] << "]"
+            json << "{\"status\":\"success\",\"film\":" << filmJson(film)->full
                  << ",\"watched\":" << (watched ? "true" : "false")
                  << ",\"liked\":" << (liked ? "true" : "false")
                  << ",\"watchlisted\":" << (watchlisted ? "true" : "false")
@@ -225,28 +568,26 @@ public:
         return "{\"status\":\"error\",\"message\":\"Film not found\"}";
     }
 
-    string searchFilms(const string& query) {
+    // Best-rated films whose titles start with query, at most limit
+    string searchFilms(const RequestContext& ctx, const string& query, int limit = SEARCH_TOP_K) {
+        shared_lock<shared_mutex> lock(dbMutex);
         if (query.length() < 2) {
             return "{\"status\":\"error\",\"message\":\"Query too short\"}";
         }
         
-        vector<int> filmIds = searchTrie->search(query);
+        vector<int> filmIds = searchTrie->search(query, limit);
         
         ostringstream json;
         json << "{\"status\":\"success\",\"films\":[";
         
         bool first = true;
         for (int filmId : filmIds) {
-            Film film;
-            if (filmTree->search(filmId, film)) {
+            const FilmJson* film = filmJson(filmId);
+            if (film) {
                 if (!first) json << ",";
                 first = false;
                 
-                json << "{\"film_id\":" << film.film_id
-                     << ",\"title\":\"" << escapeJson(film.title) << "\""
-                     << ",\"year\":" << film.release_year
-                     << ",\"director\":\"" << escapeJson(film.director) << "\""
-                     << ",\"poster_path\":\"" << escapeJson(film.poster_path) << "\"}";
+                json << film->card << "}";
             }
         }
         
@@ -254,38 +595,58 @@ public:
         return json.str();
     }
 
-    // Logs
-    string addLog(int filmId, float rating, const string& review) {
-        if (!isLoggedIn) {
-            return "{\"status\":\"error\",\"message\":\"Must be logged in\"}";
+    // Films whose title, from any word on, starts within a few typos of
+    // query: fewest edits first, then best rated
+    string fuzzySearchFilms(const RequestContext& ctx, const string& query, int limit = SEARCH_TOP_K) {
+        shared_lock<shared_mutex> lock(dbMutex);
+        if (query.length() < 2) {
+            return "{\"status\":\"error\",\"message\":\"Query too short\"}";
         }
-
-        Log newLog(nextLogId++, currentUserId, filmId, rating, review.c_str());
-        logTree->insert(newLog);
+        
+        int letters = count_if(query.begin(), query.end(), [](char c) { return c != ' '; });
+        int maxEdits = letters <= 4 ? 1 : 2;
+        vector<pair<int, int>> matches = titleWordTrie->fuzzySearch(query, maxEdits, limit,
+                                                                    chrono::microseconds(FUZZY_BUDGET_US));
         
         ostringstream json;
-        json << "{\"status\":\"success\",\"log_id\":" << newLog.log_id << "}";
+        json << "{\"status\":\"success\",\"films\":[";
+        
+        bool first = true;
+        for (const auto& match : matches) {
+            const FilmJson* film = filmJson(match.first);
+            if (film) {
+                if (!first) json << ",";
+                first = false;
+                
+                json << film->card << ",\"distance\":" << match.second << "}";
+            }
+        }
+        
+        json << "]}";
         return json.str();
     }
 
-    string getUserLogs(int userId) {
-        vector<Log> allLogs = logTree->getAllRecords();
+    // Films whose director, cast and tagline contain every query word,
+    // best BM25 score first
+    string textSearchFilms(const RequestContext& ctx, const string& query, int limit = SEARCH_TOP_K) {
+        shared_lock<shared_mutex> lock(dbMutex);
+        if (query.length() < 2) {
+            return "{\"status\":\"error\",\"message\":\"Query too short\"}";
+        }
+        
+        vector<pair<int, float>> matches = filmText->search(query, limit);
         
         ostringstream json;
-        json << "{\"status\":\"success\",\"logs\":[";
+        json << "{\"status\":\"success\",\"films\":[";
         
         bool first = true;
-        for (const auto& log : allLogs) {
-            if (log.user_id == userId) {
+        for (const auto& match : matches) {
+            const FilmJson* film = filmJson(match.first);
+            if (film) {
                 if (!first) json << ",";
                 first = false;
                 
-                json << "{\"log_id\":" << log.log_id
-                     << ",\"user_id\":" << log.user_id
-                     << ",\"film_id\":" << log.film_id
-                     << ",\"rating\":" << fixed << setprecision(1) << log.rating
-                     << ",\"review_text\":\"" << escapeJson(log.review_preview) << "\""
-                     << ",\"log_date\":" << log.watch_date << "}";
+                json << film->card << ",\"score\":" << match.second << "}";
             }
         }
         
@@ -293,81 +654,138 @@ public:
         return json.str();
     }
 
-    string getRecentLogs(int limit = 10) {
-        vector<Log> allLogs = logTree->getAllRecords();
+    // Films and users whose title or username contains query anywhere, at
+    // most limit of each; best-rated films first
+    string searchSubstring(const RequestContext& ctx, const string& query, int limit = SEARCH_TOP_K) {
+        if (query.length() < 2) {
+            return "{\"status\":\"error\",\"message\":\"Query too short\"}";
+        }
         
-        // Sort by watch_date descending
-        sort(allLogs.begin(), allLogs.end(), [](const Log& a, const Log& b) {
-            return a.watch_date > b.watch_date;
-        });
+        // Searched outside the database lock; rows are read under it below
+        vector<SuffixEntry> matches = substrings->find(query, SUBSTRING_SCAN_LIMIT);
+        
+        shared_lock<shared_mutex> lock(dbMutex);
+        ostringstream films;
+        ostringstream users;
+        int filmCount = 0;
+        int userCount = 0;
+        for (const auto& match : matches) {
+            if (match.kind == SUBSTRING_FILM && filmCount < limit) {
+                const FilmJson* film = filmJson(match.id);
+                if (!film) continue;
+                if (filmCount++ > 0) films << ",";
+                films << film->card << "}";
+            } else if (match.kind == SUBSTRING_USER && userCount < limit) {
+                const UserJson* user = userJson(match.id);
+                if (!user) continue;
+                if (userCount++ > 0) users << ",";
+                users << user->card << user->bioField << "}";
+            }
+        }
+        
+        return "{\"status\":\"success\",\"films\":[" + films.str() + "],\"users\":[" + users.str() + "]}";
+    }
+
+    // Logs
+    string addLog(const RequestContext& ctx, int filmId, float rating, const string& review) {
+        WriteGuard guard(*this);
+        if (!ctx.isLoggedIn) {
+            return "{\"status\":\"error\",\"message\":\"Must be logged in\"}";
+        }
+
+        Log newLog(nextLogId++, ctx.userId, filmId, rating, review.c_str());
+        logTree->insert(newLog);
+        suggestionEngine->invalidate(ctx.userId);
+        
+        ostringstream json;
+        json << "{\"status\":\"success\",\"log_id\":" << newLog.log_id << "}";
+        return json.str();
+    }
+
+    // The whole diary in log order, or with a [from, to) watch_date range
+    // just those entries, oldest first
+    string getUserLogs(const RequestContext& ctx, int userId, int from = INT32_MIN, int to = INT32_MAX) {
+        shared_lock<shared_mutex> lock(dbMutex);
         
         ostringstream json;
         json << "{\"status\":\"success\",\"logs\":[";
         
-        int count = 0;
-        for (const auto& log : allLogs) {
-            if (count >= limit) break;
+        bool first = true;
+        auto writeLog = [&](const Log& log) {
+            if (!first) json << ",";
+            first = false;
             
-            User user;
-            Film film;
-            if (userTree->search(log.user_id, user) && filmTree->search(log.film_id, film)) {
-                if (count > 0) json << ",";
-                json << "{\"username\":\"" << escapeJson(user.username) << "\""
-                     << ",\"film_title\":\"" << escapeJson(film.title) << "\""
-                     << ",\"rating\":" << fixed << setprecision(1) << log.rating
-                     << ",\"date\":" << log.watch_date << "}";
-                count++;
+            json << "{\"log_id\":" << log.log_id
+                 << ",\"user_id\":" << log.user_id
+                 << ",\"film_id\":" << log.film_id
+                 << ",\"rating\":" << fixed << setprecision(1) << log.rating
+                 << ",\"review_text\":\"" << escapeJson(log.review_preview) << "\""
+                 << ",\"log_date\":" << log.watch_date << "}";
+            return true;
+        };
+
+        if (from == INT32_MIN && to == INT32_MAX) {
+            vector<int> logIds;
+            logsByUser->forEachId({userId}, [&](int id) {
+                logIds.push_back(id);
+                return true;
+            });
+            sort(logIds.begin(), logIds.end());
+            for (int logId : logIds) {
+                Log log;
+                if (logTree->search(logId, log)) writeLog(log);
             }
+        } else {
+            logTree->forEachInRange(logsByUser, {userId}, from, to, false, writeLog);
         }
         
         json << "]}";
         return json.str();
     }
 
+    string getRecentLogs(const RequestContext& ctx, int limit = 10, int from = INT32_MIN, int to = INT32_MAX) {
+        shared_lock<shared_mutex> lock(dbMutex);
+        ostringstream json;
+        json << "{\"status\":\"success\",\"logs\":[";
+        writeRecentLogs(json, limit, from, to);
+        json << "]}";
+        return json.str();
+    }
+
     // Interactions
-    string toggleInteraction(int filmId, int type) {
-        if (!isLoggedIn) {
+    string toggleInteraction(const RequestContext& ctx, int filmId, int type) {
+        WriteGuard guard(*this);
+        if (!ctx.isLoggedIn) {
             return "{\"status\":\"error\",\"message\":\"Must be logged in\"}";
         }
 
-        vector<Interaction> interactions = interactionTree->getAllRecords();
-        
-        // Check if exists
-        for (const auto& inter : interactions) {
-            if (inter.user_id == currentUserId && inter.film_id == filmId && inter.type == type) {
-                // Remove
-                interactionTree->deleteRecord(inter.interaction_id);
-                return "{\"status\":\"success\",\"action\":\"removed\"}";
+        int existingId;
+        if (interactionsByKey->findId({ctx.userId, type, filmId}, existingId)) {
+            if (!interactionTree->deleteRecord(existingId)) {
+                return "{\"status\":\"error\",\"message\":\"Could not remove interaction\"}";
             }
+            return "{\"status\":\"success\",\"action\":\"removed\"}";
         }
         
-        // Add
-        Interaction newInteraction(nextInteractionId++, currentUserId, filmId, type);
+        Interaction newInteraction(nextInteractionId++, ctx.userId, filmId, type);
         interactionTree->insert(newInteraction);
         
         return "{\"status\":\"success\",\"action\":\"added\"}";
     }
 
-    string getUserWatchlist(int userId) {
-        vector<Interaction> interactions = interactionTree->getAllRecords();
-        
+    string getUserWatchlist(const RequestContext& ctx, int userId) {
+        shared_lock<shared_mutex> lock(dbMutex);
         ostringstream json;
         json << "{\"status\":\"success\",\"films\":[";
         
         bool first = true;
-        for (const auto& inter : interactions) {
-            if (inter.user_id == userId && inter.type == 2) {
-                Film film;
-                if (filmTree->search(inter.film_id, film)) {
-                    if (!first) json << ",";
-                    first = false;
-                    
-                    json << "{\"film_id\":" << film.film_id
-                         << ",\"title\":\"" << escapeJson(film.title) << "\""
-                         << ",\"year\":" << film.release_year
-                         << ",\"poster_path\":\"" << escapeJson(film.poster_path) << "\""
-                         << ",\"director\":\"" << escapeJson(film.director) << "\"}";
-                }
+        for (int filmId : interactionFilms(userId, 2)) {
+            const FilmJson* film = filmJson(filmId);
+            if (film) {
+                if (!first) json << ",";
+                first = false;
+                
+                json << film->card << "}";
             }
         }
         
@@ -375,28 +793,21 @@ public:
         return json.str();
     }
 
-    string getUserFavorites(int userId) {
-        vector<Interaction> interactions = interactionTree->getAllRecords();
-        
+    string getUserFavorites(const RequestContext& ctx, int userId) {
+        shared_lock<shared_mutex> lock(dbMutex);
         ostringstream json;
         json << "{\"status\":\"success\",\"films\":[";
         
         bool first = true;
         int count = 0;
-        for (const auto& inter : interactions) {
-            if (inter.user_id == userId && inter.type == 1 && count < 4) {
-                Film film;
-                if (filmTree->search(inter.film_id, film)) {
-                    if (!first) json << ",";
-                    first = false;
-                    
-                    json << "{\"film_id\":" << film.film_id
-                         << ",\"title\":\"" << escapeJson(film.title) << "\""
-                         << ",\"year\":" << film.release_year
-                         << ",\"vote_average\":" << fixed << setprecision(1) << film.vote_average
-                         << ",\"poster_path\":\"" << escapeJson(film.poster_path) << "\"}";
-                    count++;
-                }
+        for (int filmId : interactionFilms(userId, 1)) {
+            const FilmJson* film = filmJson(filmId);
+            if (film) {
+                if (!first) json << ",";
+                first = false;
+                
+                json << film->card << ",\"vote_average\":" << film->rating << "}";
+                if (++count == 4) break;
             }
         }
         
@@ -405,37 +816,36 @@ public:
     }
 
     // User Profile
-    string getUserProfile(int userId) {
+    string getUserProfile(const RequestContext& ctx, int userId) {
+        shared_lock<shared_mutex> lock(dbMutex);
         User user;
         if (!userTree->search(userId, user)) {
             return "{\"status\":\"error\",\"message\":\"User not found\"}";
         }
         
         // Count stats
-        vector<Log> logs = logTree->getAllRecords();
         int totalFilms = 0;
         int thisYear = 0;
-        time_t now = time(nullptr);
-        struct tm* tm_now = localtime(&now);
-        int currentYear = tm_now->tm_year + 1900;
-        
-        for (const auto& log : logs) {
-            if (log.user_id == userId) {
-                totalFilms++;
-                struct tm* tm_log = localtime(&log.watch_date);
-                if (tm_log->tm_year + 1900 == currentYear) {
-                    thisYear++;
-                }
-            }
-        }
+        struct tm tm_now = toLocalTime(time(nullptr));
+        int currentYear = tm_now.tm_year + 1900;
+        
+        // Both counts come from the (user_id, watch_date) index entries alone
+        logsByUser->forEachId({userId}, [&](int) {
+            totalFilms++;
+            return true;
+        });
+        int32_t yearStart = (int32_t)startOfYear(currentYear);
+        int32_t yearEnd = (int32_t)startOfYear(currentYear + 1);
+        logsByUser->forEachEntryInRange({userId}, yearStart, yearEnd, [&](const IndexKey<2>&) {
+            thisYear++;
+            return true;
+        });
         
-        vector<Interaction> interactions = interactionTree->getAllRecords();
         int watchlistCount = 0;
-        for (const auto& inter : interactions) {
-            if (inter.user_id == userId && inter.type == 2) {
-                watchlistCount++;
-            }
-        }
+        interactionsByKey->forEachId({userId, 2}, [&](int) {
+            watchlistCount++;
+            return true;
+        });
         
         ostringstream json;
         json << "{\"status\":\"success\",\"profile\":{"
@@ -452,7 +862,8 @@ public:
     }
 
     // Home data
-    string getHomeData() {
+    string getHomeData(const RequestContext& ctx) {
+        shared_lock<shared_mutex> lock(dbMutex);
         vector<Film> films = filmTree->getAllRecords();
         
         // Get hero film (first high-rated one)
@@ -491,35 +902,18 @@ public:
         }
         
         json << "],\"recent_logs\":[";
-        
-        // Get recent logs
-        vector<Log> allLogs = logTree->getAllRecords();
-        sort(allLogs.begin(), allLogs.end(), [](const Log& a, const Log& b) {
-            return a.watch_date > b.watch_date;
-        });
-        
-        int logCount = 0;
-        for (const auto& log : allLogs) {
-            if (logCount >= 5) break;
-            
-            User user;
-            Film film;
-            if (userTree->search(log.user_id, user) && filmTree->search(log.film_id, film)) {
-                if (logCount > 0) json << ",";
-                json << "{\"username\":\"" << escapeJson(user.username) << "\""
-                     << ",\"film_title\":\"" << escapeJson(film.title) << "\""
-                     << ",\"rating\":" << fixed << setprecision(1) << log.rating
-                     << ",\"date\":" << log.watch_date << "}";
-                logCount++;
-            }
-        }
-        
+        writeRecentLogs(json, 5);
         json << "]}";
         
         return json.str();
     }
 
-    string getAllGenres() {
+    shared_ptr<const CachedResponse> getAllGenres(const RequestContext& ctx) {
+        shared_lock<shared_mutex> lock(dbMutex);
+        return cachedResponse(genresResponse, [this] { return serializeGenres(); });
+    }
+
+    string serializeGenres() {
         vector<Genre> genres = genreTree->getAllRecords();
         
         ostringstream json;
@@ -535,10 +929,6 @@ public:
         return json.str();
     }
 
-    bool isCurrentUserAdmin() {
-        return currentUserIsAdmin;
-    }
-
 private:
     void loadInitialData() {
         vector<User> existingUsers = userTree->getAllRecords();
@@ -596,17 +986,63 @@ private:
         }
     }
     
+    // Title suffixes starting at each word: "The Dark Knight", "Dark Knight", "Knight"
+    static vector<string> titleWords(const string& title) {
+        vector<string> words;
+        for (size_t i = 0; i < title.size(); i++) {
+            if (title[i] != ' ' && (i == 0 || title[i - 1] == ' ')) {
+                words.push_back(title.substr(i));
+            }
+        }
+        return words;
+    }
+
+    static string searchableText(const Film& film) {
+        return string(film.director) + " " + film.cast_summary + " " + film.tagline;
+    }
+
+    // Adds a film to every search index
+    void indexFilm(const Film& film) {
+        searchTrie->insert(film.title, film.film_id, film.vote_average);
+        for (const string& words : titleWords(film.title)) {
+            titleWordTrie->insert(words, film.film_id, film.vote_average);
+        }
+        filmText->add(film.film_id, searchableText(film));
+    }
+
+    void unindexFilm(const Film& film) {
+        searchTrie->remove(film.title, film.film_id);
+        for (const string& words : titleWords(film.title)) {
+            titleWordTrie->remove(words, film.film_id);
+        }
+        filmText->remove(film.film_id, searchableText(film));
+    }
+
     void buildSearchIndex() {
         vector<Film> films = filmTree->getAllRecords();
         cout << "Building search index with " << films.size() << " films..." << endl;
         
         for (const auto& film : films) {
-            searchTrie->insert(film.title, film.film_id);
+            indexFilm(film);
         }
         
         cout << "Search index built successfully!" << endl;
     }
     
+    // What the substring index is built from; runs on its builder thread
+    vector<SuffixEntry> substringEntries() {
+        shared_lock<shared_mutex> lock(dbMutex);
+        vector<SuffixEntry> entries;
+        for (const auto& film : filmTree->getAllRecords()) {
+            entries.push_back({film.film_id, SUBSTRING_FILM, film.vote_average, film.title});
+        }
+        for (const auto& user : userTree->getAllRecords()) {
+            if (user.isAdmin) continue;
+            entries.push_back({user.user_id, SUBSTRING_USER, 0.0f, user.username});
+        }
+        return entries;
+    }
+
     void buildUserIndex() {
         vector<User> users = userTree->getAllRecords();
         cout << "Building user index with " << users.size() << " users..." << endl;
@@ -622,16 +1058,19 @@ private:
     
 public:
     // Social Graph Methods
-    string followUser(int targetId) {
-        if (!isLoggedIn) {
+    string followUser(const RequestContext& ctx, int targetId) {
+        WriteGuard guard(*this);
+        if (!ctx.isLoggedIn) {
             return "{\"status\":\"error\",\"message\":\"Must be logged in\"}";
         }
         
-        if (currentUserId == targetId) {
+        if (ctx.userId == targetId) {
             return "{\"status\":\"error\",\"message\":\"Cannot follow yourself\"}";
         }
         
-        bool success = socialGraph->followUser(currentUserId, targetId);
+        User target;
+        bool success = userTree->search(targetId, target) && socialGraph->followUser(ctx.userId, targetId);
+        if (success) suggestionEngine->invalidate(ctx.userId);
         
         ostringstream json;
         json << "{\"status\":\"" << (success ? "success" : "error") << "\"";
@@ -644,12 +1083,14 @@ public:
         return json.str();
     }
     
-    string unfollowUser(int targetId) {
-        if (!isLoggedIn) {
+    string unfollowUser(const RequestContext& ctx, int targetId) {
+        WriteGuard guard(*this);
+        if (!ctx.isLoggedIn) {
             return "{\"status\":\"error\",\"message\":\"Must be logged in\"}";
         }
         
-        bool success = socialGraph->unfollowUser(currentUserId, targetId);
+        bool success = socialGraph->unfollowUser(ctx.userId, targetId);
+        if (success) suggestionEngine->invalidate(ctx.userId);
         
         ostringstream json;
         json << "{\"status\":\"" << (success ? "success" : "error") << "\"";
@@ -662,10 +1103,11 @@ public:
         return json.str();
     }
     
-    string getUserSocial(int userId) {
+    string getUserSocial(const RequestContext& ctx, int userId) {
+        shared_lock<shared_mutex> lock(dbMutex);
         int followersCount = socialGraph->getFollowersCount(userId);
         int followingCount = socialGraph->getFollowingCount(userId);
-        bool isFollowingUser = isLoggedIn ? socialGraph->isFollowing(currentUserId, userId) : false;
+        bool isFollowingUser = ctx.isLoggedIn ? socialGraph->isFollowing(ctx.userId, userId) : false;
         
         ostringstream json;
         json << "{\"status\":\"success\"";
@@ -676,7 +1118,8 @@ public:
         return json.str();
     }
     
-    string getUserNetwork(int userId) {
+    string getUserNetwork(const RequestContext& ctx, int userId) {
+        shared_lock<shared_mutex> lock(dbMutex);
         vector<int> following = socialGraph->getFollowing(userId);
         vector<int> followers = socialGraph->getFollowers(userId);
         
@@ -685,13 +1128,11 @@ public:
         
         bool first = true;
         for (int followedId : following) {
-            User user;
-            if (userTree->search(followedId, user)) {
+            const UserJson* user = userJson(followedId);
+            if (user) {
                 if (!first) json << ",";
                 first = false;
-                json << "{\"user_id\":" << user.user_id
-                     << ",\"username\":\"" << escapeJson(user.username) << "\""
-                     << ",\"avatar_id\":" << user.avatar_id << "}";
+                json << user->card << "}";
             }
         }
         
@@ -699,13 +1140,11 @@ public:
         
         first = true;
         for (int followerId : followers) {
-            User user;
-            if (userTree->search(followerId, user)) {
+            const UserJson* user = userJson(followerId);
+            if (user) {
                 if (!first) json << ",";
                 first = false;
-                json << "{\"user_id\":" << user.user_id
-                     << ",\"username\":\"" << escapeJson(user.username) << "\""
-                     << ",\"avatar_id\":" << user.avatar_id << "}";
+                json << user->card << "}";
             }
         }
         
@@ -713,8 +1152,36 @@ public:
         return json.str();
     }
     
+    // People the user may know: second-degree follows ranked by mutual
+    // follows, then films logged in common
+    string getUserSuggestions(const RequestContext& ctx, int userId, int limit) {
+        shared_lock<shared_mutex> lock(dbMutex);
+        vector<Suggestion> suggestions = suggestionEngine->suggest(
+            userId, [this](int id, vector<int>& films) { loggedFilms(id, films); });
+        
+        ostringstream json;
+        json << "{\"status\":\"success\",\"suggestions\":[";
+        
+        int count = 0;
+        for (const auto& suggestion : suggestions) {
+            if (count >= limit) break;
+            const UserJson* user = userJson(suggestion.userId);
+            // Deleted users may linger in a cached ranking; the admin stays hidden
+            if (!user || user->isAdmin) continue;
+            if (count++ > 0) json << ",";
+            json << user->card
+                 << ",\"mutual_follows\":" << suggestion.mutualFollows
+                 << ",\"shared_films\":" << suggestion.sharedFilms
+                 << ",\"score\":" << suggestion.score << "}";
+        }
+        
+        json << "]}";
+        return json.str();
+    }
+    
     // User Search
-    string searchUsers(const string& query) {
+    string searchUsers(const RequestContext& ctx, const string& query) {
+        shared_lock<shared_mutex> lock(dbMutex);
         vector<int> userIds = userTrie->search(query);
         
         ostringstream json;
@@ -725,15 +1192,12 @@ public:
         for (int userId : userIds) {
             if (count >= 20) break; // Limit to 20 results
             
-            User user;
-            if (userTree->search(userId, user)) {
+            const UserJson* user = userJson(userId);
+            if (user) {
                 if (!first) json << ",";
                 first = false;
                 
-                json << "{\"user_id\":" << user.user_id
-                     << ",\"username\":\"" << escapeJson(user.username) << "\""
-                     << ",\"avatar_id\":" << user.avatar_id
-                     << ",\"bio\":\"" << escapeJson(user.bio) << "\"}";
+                json << user->card << user->bioField << "}";
                 count++;
             }
         }
@@ -743,12 +1207,20 @@ public:
     }
     
     // Admin Methods
-    string adminDeleteFilm(int filmId) {
-        if (!isLoggedIn || !currentUserIsAdmin) {
+    string adminDeleteFilm(const RequestContext& ctx, int filmId) {
+        WriteGuard guard(*this);
+        if (!ctx.isLoggedIn || !ctx.isAdmin) {
             return "{\"status\":\"error\",\"message\":\"Unauthorized\"}";
         }
         
-        bool success = filmTree->deleteRecord(filmId);
+        Film film;
+        bool success = filmTree->search(filmId, film) && filmTree->deleteRecord(filmId);
+        if (success) {
+            unindexFilm(film);
+            filmFragments.invalidate(filmId);
+            substrings->requestRebuild();
+            catalogueVersion++;
+        }
         
         ostringstream json;
         json << "{\"status\":\"" << (success ? "success" : "error") << "\"";
@@ -759,8 +1231,9 @@ public:
         return json.str();
     }
     
-    string adminDeleteUser(int userId) {
-        if (!isLoggedIn || !currentUserIsAdmin) {
+    string adminDeleteUser(const RequestContext& ctx, int userId) {
+        WriteGuard guard(*this);
+        if (!ctx.isLoggedIn || !ctx.isAdmin) {
             return "{\"status\":\"error\",\"message\":\"Unauthorized\"}";
         }
         
@@ -769,6 +1242,10 @@ public:
         }
         
         bool success = userTree->deleteRecord(userId);
+        if (success) {
+            userFragments.invalidate(userId);
+            substrings->requestRebuild();
+        }
         
         ostringstream json;
         json << "{\"status\":\"" << (success ? "success" : "error") << "\"";
@@ -779,11 +1256,12 @@ public:
         return json.str();
     }
     
-    string adminAddFilm(const string& title, int year, int runtime, float rating,
+    string adminAddFilm(const RequestContext& ctx, const string& title, int year, int runtime, float rating,
                        const string& director, const string& cast, const string& tagline,
                        const string& overview, const string& posterPath, const string& backdropPath,
                        const vector<int>& genreIds) {
-        if (!isLoggedIn || !currentUserIsAdmin) {
+        WriteGuard guard(*this);
+        if (!ctx.isLoggedIn || !ctx.isAdmin) {
             return "{\"status\":\"error\",\"message\":\"Unauthorized\"}";
         }
         
@@ -819,15 +1297,19 @@ public:
         }
         
         filmTree->insert(newFilm);
-        searchTrie->insert(newFilm.title, newFilm.film_id);
+        filmFragments.invalidate(newFilm.film_id);
+        indexFilm(newFilm);
+        substrings->requestRebuild();
+        catalogueVersion++;
         
         ostringstream json;
         json << "{\"status\":\"success\",\"film_id\":" << newFilm.film_id << "}";
         return json.str();
     }
     
-    string adminGetAllUsers() {
-        if (!isLoggedIn || !currentUserIsAdmin) {
+    string adminGetAllUsers(const RequestContext& ctx) {
+        shared_lock<shared_mutex> lock(dbMutex);
+        if (!ctx.isLoggedIn || !ctx.isAdmin) {
             return "{\"status\":\"error\",\"message\":\"Unauthorized\"}";
         }
         
@@ -851,4 +1333,31 @@ public:
         json << "]}";
         return json.str();
     }
+
+    string adminGetStorageStats(const RequestContext& ctx) {
+        if (!ctx.isLoggedIn || !ctx.isAdmin) {
+            return "{\"status\":\"error\",\"message\":\"Unauthorized\"}";
+        }
+
+        BufferPoolStats stats = bufferPool->getStats();
+        WALStats logStats = wal->getStats();
+        size_t lookups = stats.hits + stats.misses;
+
+        ostringstream json;
+        json << "{\"status\":\"success\",\"buffer_pool\":{"
+             << "\"hits\":" << stats.hits
+             << ",\"misses\":" << stats.misses
+             << ",\"hit_rate\":" << fixed << setprecision(4) << (lookups ? (double)stats.hits / lookups : 0.0)
+             << ",\"evictions\":" << stats.evictions
+             << ",\"writebacks\":" << stats.writebacks
+             << ",\"pages\":" << stats.pages
+             << ",\"bytes\":" << stats.bytes
+             << ",\"capacity\":" << stats.capacity << "}"
+             << ",\"wal\":{"
+             << "\"commits\":" << logStats.commits
+             << ",\"syncs\":" << logStats.syncs
+             << ",\"checkpoints\":" << logStats.checkpoints
+             << ",\"bytes\":" << logStats.bytes << "}}";
+        return json.str();
+    }
 };
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../ds/SuffixArray.h"
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// Substring search over a SuffixArray that is rebuilt off the request path.
+// Writers call requestRebuild(), which only flags the work; a background
+// thread loads the current entries, builds a new array and swaps it in with
+// one atomic pointer store. Queries keep using whichever array they loaded,
+// so a rebuild never blocks them. Requests made during a rebuild coalesce
+// into one more rebuild.
+class SubstringSearch {
+private:
+    shared_ptr<const SuffixArray> current;
+    function<vector<SuffixEntry>()> loadEntries;
+
+    thread builder;
+    mutex buildMutex;
+    condition_variable buildReady;
+    bool rebuildPending;
+    bool stopping;
+
+    void buildLoop() {
+        unique_lock<mutex> lock(buildMutex);
+        while (true) {
+            buildReady.wait(lock, [this] { return rebuildPending || stopping; });
+            if (stopping) return;
+
+            rebuildPending = false;
+            lock.unlock();
+            shared_ptr<const SuffixArray> next = make_shared<SuffixArray>(loadEntries());
+            atomic_store(&current, next);
+            lock.lock();
+        }
+    }
+
+public:
+    // load runs on the builder thread and must take whatever locks it needs
+    SubstringSearch(function<vector<SuffixEntry>()> load) : loadEntries(load), rebuildPending(false), stopping(false) {
+        current = make_shared<SuffixArray>(loadEntries());
+        builder = thread(&SubstringSearch::buildLoop, this);
+    }
+
+    ~SubstringSearch() {
+        {
+            lock_guard<mutex> lock(buildMutex);
+            stopping = true;
+        }
+        buildReady.notify_one();
+        builder.join();
+    }
+
+    void requestRebuild() {
+        {
+            lock_guard<mutex> lock(buildMutex);
+            rebuildPending = true;
+        }
+        buildReady.notify_one();
+    }
+
+    vector<SuffixEntry> find(const string& query, size_t scanLimit) const {
+        shared_ptr<const SuffixArray> snapshot = atomic_load(&current);
+        return snapshot->find(query, scanLimit);
+    }
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "../ds/SocialGraph.h"
+#include "../utils/ThreadPool.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+// Follows of the user that seed the search, and follows read per seed
+#define SUGGESTION_MAX_SOURCES 2000
+#define SUGGESTION_MAX_FANOUT 1000
+// Candidates, best mutual counts first, that get a film overlap check
+#define SUGGESTION_FILM_CANDIDATES 50
+// Ranked suggestions kept per user
+#define SUGGESTION_CACHE_RESULTS 50
+#define SUGGESTION_CACHE_USERS 4096
+// How stale a cached ranking may get through other users' changes
+#define SUGGESTION_CACHE_TTL_SECONDS 30
+#define SUGGESTION_MUTUAL_WEIGHT 3
+
+struct Suggestion {
+    int userId;
+    int mutualFollows; // people the user follows who follow this user
+    int sharedFilms;   // distinct films both have logged
+    int score;
+};
+
+// "People you may know": users two follows away, ranked by mutual follows
+// and then by films logged in common.
+//
+// The second hop is a multi-source BFS: the user's follows (at most
+// SUGGESTION_MAX_SOURCES, evenly sampled) have their follows (at most
+// SUGGESTION_MAX_FANOUT each) counted on a dedicated pool, each worker owning
+// a range of user ids. The best candidates then get their film overlap
+// counted, again in parallel. The pool is separate from the HTTP workers so
+// a request never waits on tasks queued behind itself.
+//
+// Rankings are cached per user. An entry is dropped when the user follows,
+// unfollows or logs a film; what other users do (their follows, their logs)
+// shows up once the entry is SUGGESTION_CACHE_TTL_SECONDS old, so one busy
+// account does not evict everyone's ranking. Callers hold the database lock
+// shared, which keeps the graph and trees still while the workers read them.
+class SuggestionEngine {
+private:
+    struct CachedRanking {
+        chrono::steady_clock::time_point computed;
+        vector<Suggestion> ranked;
+    };
+
+    SocialGraph* graph;
+    ThreadPool* pool;
+    mutex cacheMutex;
+    unordered_map<int, CachedRanking> cache;
+
+    // Runs work(0..tasks-1) on the pool and waits for all of them
+    template<typename Work>
+    void runParallel(size_t tasks, Work work) {
+        vector<future<void>> done;
+        for (size_t i = 0; i < tasks; i++) {
+            auto task = make_shared<packaged_task<void()>>([&work, i] { work(i); });
+            done.push_back(task->get_future());
+            pool->submit([task] { (*task)(); });
+        }
+        for (auto& f : done) {
+            f.get();
+        }
+    }
+
+    static int sharedCount(const vector<int>& a, const vector<int>& b) {
+        int count = 0;
+        size_t i = 0, j = 0;
+        while (i < a.size() && j < b.size()) {
+            if (a[i] < b[j]) {
+                i++;
+            } else if (b[j] < a[i]) {
+                j++;
+            } else {
+                count++;
+                i++;
+                j++;
+            }
+        }
+        return count;
+    }
+
+    // filmsOf(userId, films) fills the user's distinct logged film ids, sorted
+    template<typename FilmLookup>
+    vector<Suggestion> rank(int userId, FilmLookup filmsOf) {
+        vector<int> following = graph->getFollowing(userId);
+        if (following.empty()) return vector<Suggestion>();
+
+        vector<int> sources;
+        if (following.size() <= SUGGESTION_MAX_SOURCES) {
+            sources = following;
+        } else {
+            double stride = (double)following.size() / SUGGESTION_MAX_SOURCES;
+            for (int i = 0; i < SUGGESTION_MAX_SOURCES; i++) {
+                sources.push_back(following[(size_t)(i * stride)]);
+            }
+        }
+
+        // Hop two. Counts live in one dense array indexed by user id; each
+        // task walks every source but only counts the id range it owns, so
+        // tasks never share a slot and nothing needs merging afterwards.
+        int bound = graph->getUserBound();
+        size_t tasks = pool->size();
+        vector<uint16_t> counts(bound, 0);
+        vector<vector<int>> reached(tasks);
+        runParallel(tasks, [&](size_t task) {
+            int lo = (int)((int64_t)bound * task / tasks);
+            int hi = (int)((int64_t)bound * (task + 1) / tasks);
+            for (int source : sources) {
+                int visited = 0;
+                graph->forEachFollowing(source, [&](int candidate) {
+                    if (candidate >= lo && candidate < hi && candidate != userId && counts[candidate]++ == 0) {
+                        reached[task].push_back(candidate);
+                    }
+                    return ++visited < SUGGESTION_MAX_FANOUT;
+                });
+            }
+        });
+
+        vector<Suggestion> candidates;
+        for (const auto& ids : reached) {
+            for (int candidate : ids) {
+                if (!binary_search(following.begin(), following.end(), candidate)) {
+                    candidates.push_back({candidate, counts[candidate], 0, 0});
+                }
+            }
+        }
+        size_t kept = min(candidates.size(), (size_t)SUGGESTION_FILM_CANDIDATES);
+        partial_sort(candidates.begin(), candidates.begin() + kept, candidates.end(),
+                     [](const Suggestion& a, const Suggestion& b) {
+                         if (a.mutualFollows != b.mutualFollows) return a.mutualFollows > b.mutualFollows;
+                         return a.userId < b.userId;
+                     });
+        candidates.resize(kept);
+
+        // Film overlap for the short list
+        vector<int> films;
+        filmsOf(userId, films);
+        if (!films.empty()) {
+            size_t filmTasks = min(pool->size(), candidates.size());
+            runParallel(filmTasks, [&](size_t task) {
+                vector<int> theirs;
+                for (size_t c = task; c < candidates.size(); c += filmTasks) {
+                    filmsOf(candidates[c].userId, theirs);
+                    candidates[c].sharedFilms = sharedCount(films, theirs);
+                }
+            });
+        }
+
+        for (auto& candidate : candidates) {
+            candidate.score = candidate.mutualFollows * SUGGESTION_MUTUAL_WEIGHT + candidate.sharedFilms;
+        }
+        sort(candidates.begin(), candidates.end(), [](const Suggestion& a, const Suggestion& b) {
+            if (a.score != b.score) return a.score > b.score;
+            if (a.mutualFollows != b.mutualFollows) return a.mutualFollows > b.mutualFollows;
+            return a.userId < b.userId;
+        });
+        if (candidates.size() > SUGGESTION_CACHE_RESULTS) {
+            candidates.resize(SUGGESTION_CACHE_RESULTS);
+        }
+        return candidates;
+    }
+
+public:
+    SuggestionEngine(SocialGraph* socialGraph, size_t threads = thread::hardware_concurrency())
+        : graph(socialGraph) {
+        pool = new ThreadPool(max(threads, (size_t)2));
+    }
+
+    ~SuggestionEngine() {
+        delete pool;
+    }
+
+    // Best suggestions first, at most SUGGESTION_CACHE_RESULTS
+    template<typename FilmLookup>
+    vector<Suggestion> suggest(int userId, FilmLookup filmsOf) {
+        auto now = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            auto it = cache.find(userId);
+            if (it != cache.end() && now - it->second.computed < chrono::seconds(SUGGESTION_CACHE_TTL_SECONDS)) {
+                return it->second.ranked;
+            }
+        }
+
+        vector<Suggestion> ranked = rank(userId, filmsOf);
+
+        lock_guard<mutex> lock(cacheMutex);
+        if (cache.size() >= SUGGESTION_CACHE_USERS) {
+            cache.clear();
+        }
+        cache[userId] = {now, ranked};
+        return ranked;
+    }
+
+    // Called with the database lock held exclusively after the user's own
+    // follows or logs changed, so no ranking for them is being computed
+    void invalidate(int userId) {
+        lock_guard<mutex> lock(cacheMutex);
+        cache.erase(userId);
+    }
+};
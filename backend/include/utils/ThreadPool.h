@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+// Fixed-size pool of worker threads draining a FIFO task queue
+class ThreadPool {
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex queueMutex;
+    condition_variable condition;
+    bool stopping;
+
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    ThreadPool(size_t threadCount = thread::hardware_concurrency()) : stopping(false) {
+        if (threadCount == 0) threadCount = 1;
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            tasks.push(move(task));
+        }
+        condition.notify_one();
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+};
@@ -1,12 +1,19 @@
 #include "../include/network/HTTPServer.h"
 #include <iostream>
+
+#ifdef _WIN32
 #include <direct.h>
+#define makeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define makeDirectory(path) mkdir(path, 0755)
+#endif
 
 using namespace std;
 
 int main() {
     // Create data directory if it doesn't exist
-    _mkdir("data");
+    makeDirectory("data");
     
     cout << "==================================" << endl;
     cout << "    CINELOG Backend Server" << endl;
@@ -0,0 +1,21 @@
+#!/bin/sh
+echo "====================================="
+echo " Compiling Cinelog Backend"
+echo "====================================="
+echo
+
+cd "$(dirname "$0")/backend" || exit 1
+if g++ -std=c++17 -O2 -pthread -o server src/main.cpp; then
+    echo
+    echo "====================================="
+    echo " Compilation Successful!"
+    echo "====================================="
+    echo
+    echo "Run 'cd backend && ./server' to start the server"
+else
+    echo
+    echo "====================================="
+    echo " Compilation Failed!"
+    echo "====================================="
+    exit 1
+fi